@@ -0,0 +1,1089 @@
+//------------------------------------------------------------------------------
+// Name:        SDL-BGI_Clock_T-D_headless.c
+// Purpose:     Run the Time Dilation Clock without a display, for testing and
+//              measuring the frame loop.
+// Title:       "Time Dilation Clock - headless"
+//
+// Platform:    Ubuntu64
+//
+// Compiler:    GCC V9.x.x (ISO C99)
+// Depends:     graphics.h (headless), ../SDL-BGI_Clock_T-D.c
+// Build:       gcc -O2 -IHeadless Headless/SDL-BGI_Clock_T-D_headless.c
+//              -o clock_headless -lquadmath -lm -lpthread -lrt
+//              Add -O3 -march=native to time the vectorized TD loop (-b td).
+//
+// Author:      Axle
+// Licence:     MIT
+//------------------------------------------------------------------------------
+// NOTES:
+// The clock source is compiled as is against a stand in for SDL_bgi that draws
+// into ARGB pages in memory. Nothing is shown. What the clock uploads to the
+// texture, and when it presents, is counted so the cost of each frame can be
+// compared between builds of the clock.
+//
+// Usage:
+//   clock_headless [-n frames] [-d WxH] [-c] [-k frame:key]...
+//   clock_headless -b hands|td
+//     -n frames    Run for this many presented frames (default 5000), then
+//                  close the window.
+//     -d WxH       Desktop size used for full screen (default 1920x1080).
+//     -c           Check every present. The texture must match the page the
+//                  clock drew, or the frame is counted as a mismatch.
+//     -k frame:key Press key at that frame. key is a single character or one
+//                  of shift, ctrl, alt, kp+, kp-, esc, close (the window close
+//                  button).
+//     -b hands     Don't run the clock, benchmark the hand engine instead.
+//                  HandPoint() is timed against lookups in the 12, 60 and 3600
+//                  entry hand tables the clock used before it, built with the
+//                  old code, and the pixels of both are compared at each tick.
+//     -b td        Don't run the clock, benchmark the TD hand instead. The
+//                  plain double path (as the clock has it and with its rates
+//                  worked out once) and the precise path are timed per radius
+//                  point, and both are checked against a __float128 reference
+//                  for 500 and 4000 radius points, zoom levels 0 to 12 and
+//                  up to INT_MAX - 7200 ticks.
+//
+// fputpixel() in SDL_bgi does not clip. Here a pixel outside the page is not
+// written but counted, and any count above 0 is a bug in the clock.
+//
+// This is a test double, not a renderer. Lines, circles and text are close
+// enough to the real ones to exercise the erase and present logic, but are not
+// pixel exact with SDL_bgi.
+//------------------------------------------------------------------------------
+
+// The clock itself, with its main() renamed so this file can drive it.
+#define main ClockMain
+#include "../SDL-BGI_Clock_T-D.c"
+#undef main
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <quadmath.h>
+
+#define HEADLESS_WINDOWS 8
+#define HEADLESS_KEYS 64
+#define HEADLESS_BENCH_FRAMES 20000000
+#define HEADLESS_BENCH_POINTS 100000000
+
+typedef struct
+    {
+    int open;
+    int width, height;
+    Uint32 *page[2];
+    Uint32 *texture;
+    int active, visual;
+    } HeadlessWindow;
+
+typedef struct
+    {
+    long long frame;
+    int close;  // 1 == the window close button rather than a key.
+    SDL_Keycode key;
+    } HeadlessKey;
+
+// SDL_bgi globals the clock uses directly.
+SDL_Texture *bgi_texture = NULL;
+SDL_Renderer *bgi_renderer = NULL;
+Uint32 *bgi_activepage[HEADLESS_WINDOWS];
+
+static HeadlessWindow Win[HEADLESS_WINDOWS];
+static int Cur = -1;
+static Uint32 Win_flags = 0;
+static int Desktop_w = 1920, Desktop_h = 1080;
+
+static int Color = WHITE, Fill_color = BLACK;
+static int Text_horiz = LEFT_TEXT;
+static int Pos_x = 0, Pos_y = 0;
+
+static HeadlessKey Keys[HEADLESS_KEYS];
+static int Key_count = 0, Key_next = 0;
+
+static long long Max_frames = 5000;
+static int Check = 0;
+
+// Results.
+static long long Frames = 0;
+static long long Upload_bytes = 0;
+static long long Full_refreshes = 0;
+static long long Mismatches = 0;
+static long long Off_page = 0;
+static int Last_radii = -1;
+static int Last_zoom = -1;
+static struct timespec Start_ts, End_ts;
+
+// The 16 BGI colours as ARGB.
+static const Uint32 Palette[16] =
+    {
+    0xFF000000, 0xFF0000AA, 0xFF00AA00, 0xFF00AAAA, 0xFFAA0000, 0xFFAA00AA,
+    0xFFAA5500, 0xFFAAAAAA, 0xFF555555, 0xFF5555FF, 0xFF55FF55, 0xFF55FFFF,
+    0xFFFF5555, 0xFFFF55FF, 0xFFFFFF55, 0xFFFFFFFF
+    };
+
+
+static void PutPixel(int x, int y, int color)
+    {
+    HeadlessWindow *w = &Win[Cur];
+
+    if (x >= 0 && y >= 0 && x < w->width && y < w->height)
+        {
+        w->page[w->active][y * w->width + x] = Palette[color & 15];
+        }
+    }
+
+
+// Show the texture. With -c the texture must hold exactly what is on the
+// visible page.
+static void Present(void)
+    {
+    HeadlessWindow *w = &Win[Cur];
+
+    if (Frames == 0)
+        {
+        clock_gettime(CLOCK_MONOTONIC, &Start_ts);
+        }
+    Frames++;
+    clock_gettime(CLOCK_MONOTONIC, &End_ts);
+
+    if (Check && memcmp(w->texture, w->page[w->visual],
+                        (size_t)w->width * w->height * sizeof(Uint32)) != 0)
+        {
+        Mismatches++;
+        }
+    }
+
+
+// The next scripted key, if its frame has come. After the last frame the
+// window is closed.
+static int NextKey(int *close, SDL_Keycode *key)
+    {
+    if (Key_next < Key_count && Keys[Key_next].frame <= Frames)
+        {
+        *close = Keys[Key_next].close;
+        *key = Keys[Key_next].key;
+        Key_next++;
+        return 1;
+        }
+    if (Frames >= Max_frames)
+        {
+        *close = 1;
+        *key = 0;
+        return 1;
+        }
+    return 0;
+    }
+
+
+//==============================================================================
+// SDL2
+
+int SDL_UpdateTexture(SDL_Texture *texture, const SDL_Rect *rect,
+                      const void *pixels, int pitch)
+    {
+    HeadlessWindow *w = (HeadlessWindow*)texture;
+    const Uint32 *src = (const Uint32*)pixels;
+    int y;
+
+    for (y = 0; y < rect->h; y++)
+        {
+        memcpy(&w->texture[(rect->y + y) * w->width + rect->x],
+               src + y * (pitch / (int)sizeof(Uint32)), rect->w * sizeof(Uint32));
+        }
+    Upload_bytes += (long long)rect->w * rect->h * sizeof(Uint32);
+    return 0;
+    }
+
+
+int SDL_RenderCopy(SDL_Renderer *renderer, SDL_Texture *texture,
+                   const SDL_Rect *srcrect, const SDL_Rect *dstrect)
+    {
+    (void)renderer;
+    (void)texture;
+    (void)srcrect;
+    (void)dstrect;
+    return 0;
+    }
+
+
+void SDL_RenderPresent(SDL_Renderer *renderer)
+    {
+    (void)renderer;
+    Present();
+    }
+
+
+void SDL_Delay(Uint32 ms)
+    {
+    (void)ms;  // Run flat out, the frame time is what is measured.
+    }
+
+
+int SDL_PollEvent(SDL_Event *event)
+    {
+    int close;
+    SDL_Keycode key;
+
+    if (!NextKey(&close, &key))
+        {
+        return 0;
+        }
+    memset(event, 0, sizeof(*event));
+    if (close)
+        {
+        event->window.type = SDL_WINDOWEVENT;
+        event->window.event = SDL_WINDOWEVENT_CLOSE;
+        }
+    else
+        {
+        event->key.type = SDL_KEYDOWN;
+        event->key.keysym.sym = key;
+        }
+    return 1;
+    }
+
+
+//==============================================================================
+// SDL_bgi
+
+void setwinoptions(char *title, int x, int y, Uint32 flags)
+    {
+    (void)title;
+    (void)x;
+    (void)y;
+    if (flags != (Uint32)-1)
+        {
+        Win_flags = flags;
+        }
+    }
+
+
+void resetwinoptions(int id, char *title, int x, int y)
+    {
+    (void)id;
+    (void)title;
+    (void)x;
+    (void)y;
+    }
+
+
+int initwindow(int width, int height)
+    {
+    int id;
+    HeadlessWindow *w;
+
+    for (id = 0; id < HEADLESS_WINDOWS && Win[id].open; id++)
+        {
+        }
+    if (id == HEADLESS_WINDOWS)
+        {
+        fprintf(stderr, "headless: out of windows\n");
+        exit(1);
+        }
+
+    w = &Win[id];
+    if ((Win_flags & SDL_WINDOW_FULLSCREEN) || (width == 0 && height == 0))
+        {
+        width = Desktop_w;
+        height = Desktop_h;
+        }
+    w->width = width;
+    w->height = height;
+    w->page[0] = (Uint32*)calloc((size_t)width * height, sizeof(Uint32));
+    w->page[1] = (Uint32*)calloc((size_t)width * height, sizeof(Uint32));
+    w->texture = (Uint32*)calloc((size_t)width * height, sizeof(Uint32));
+    if (w->page[0] == NULL || w->page[1] == NULL || w->texture == NULL)
+        {
+        fprintf(stderr, "headless: out of memory\n");
+        exit(1);
+        }
+    w->active = 0;
+    w->visual = 0;
+    w->open = 1;
+    setcurrentwindow(id);
+    printf("frame %lld: window %d opened at %dx%d\n", Frames, id, width, height);
+    return id;
+    }
+
+
+void closewindow(int id)
+    {
+    if (id < 0 || id >= HEADLESS_WINDOWS || !Win[id].open)
+        {
+        return;
+        }
+    free(Win[id].page[0]);
+    free(Win[id].page[1]);
+    free(Win[id].texture);
+    memset(&Win[id], 0, sizeof(Win[id]));
+    bgi_activepage[id] = NULL;
+    }
+
+
+void setcurrentwindow(int id)
+    {
+    Cur = id;
+    bgi_activepage[id] = Win[id].page[Win[id].active];
+    bgi_texture = (SDL_Texture*)&Win[id];
+    bgi_renderer = (SDL_Renderer*)&Win[id];
+    }
+
+
+void closegraph(void)
+    {
+    int id;
+
+    for (id = 0; id < HEADLESS_WINDOWS; id++)
+        {
+        closewindow(id);
+        }
+    }
+
+
+void sdlbgifast(void)
+    {
+    }
+
+
+int getmaxx(void)
+    {
+    return Win[Cur].width - 1;
+    }
+
+
+int getmaxy(void)
+    {
+    return Win[Cur].height - 1;
+    }
+
+
+void refresh(void)
+    {
+    HeadlessWindow *w = &Win[Cur];
+
+    memcpy(w->texture, w->page[w->visual], (size_t)w->width * w->height * sizeof(Uint32));
+    Upload_bytes += (long long)w->width * w->height * sizeof(Uint32);
+    Full_refreshes++;
+    Present();
+    }
+
+
+void cleardevice(void)
+    {
+    HeadlessWindow *w = &Win[Cur];
+
+    memset(w->page[w->active], 0, (size_t)w->width * w->height * sizeof(Uint32));
+    }
+
+
+int getvisualpage(void)
+    {
+    return Win[Cur].visual;
+    }
+
+
+int getactivepage(void)
+    {
+    return Win[Cur].active;
+    }
+
+
+void setvisualpage(int page)
+    {
+    Win[Cur].visual = page & 1;
+    }
+
+
+void setactivepage(int page)
+    {
+    Win[Cur].active = page & 1;
+    bgi_activepage[Cur] = Win[Cur].page[Win[Cur].active];
+    }
+
+
+void setcolor(int color)
+    {
+    Color = color;
+    }
+
+
+void setfillstyle(int pattern, int color)
+    {
+    (void)pattern;
+    Fill_color = color;
+    }
+
+
+void setlinestyle(int linestyle, unsigned upattern, int thickness)
+    {
+    (void)linestyle;
+    (void)upattern;
+    (void)thickness;
+    }
+
+
+void settextstyle(int font, int direction, int charsize)
+    {
+    (void)font;
+    (void)direction;
+    (void)charsize;
+    }
+
+
+void settextjustify(int horiz, int vert)
+    {
+    (void)vert;
+    Text_horiz = horiz;
+    }
+
+
+int textwidth(char *textstring)
+    {
+    return 9 * (int)strlen(textstring);
+    }
+
+
+int textheight(char *textstring)
+    {
+    (void)textstring;
+    return 14;
+    }
+
+
+// Text is a pattern of pixels that follows the characters, so changed text
+// changes the pixels. Vertically centred as the clock uses CENTER_TEXT.
+void outtextxy(int x, int y, char *textstring)
+    {
+    int width = textwidth(textstring);
+    int i, j, radii, zoom;
+
+    // Report what the clock says in its stats when it changes.
+    if (sscanf(textstring, "Radius step * %d", &radii) == 1 && radii != Last_radii)
+        {
+        printf("frame %lld: drawing with the tables for radius %d\n", Frames, radii);
+        Last_radii = radii;
+        }
+    if (sscanf(textstring, "TD band: %*s to 1c (zoom %d", &zoom) == 1 && zoom != Last_zoom)
+        {
+        printf("frame %lld: zoom %d\n", Frames, zoom);
+        Last_zoom = zoom;
+        }
+
+    if (Text_horiz == CENTER_TEXT)
+        {
+        x -= width / 2;
+        }
+    for (j = y - 7; j < y + 7; j++)
+        {
+        for (i = x; i < x + width; i++)
+            {
+            if ((i * 7 + j * 3 + (unsigned char)textstring[(i - x) / 9]) % 5 == 0)
+                {
+                PutPixel(i, j, Color);
+                }
+            }
+        }
+    }
+
+
+void moveto(int x, int y)
+    {
+    Pos_x = x;
+    Pos_y = y;
+    }
+
+
+void outtext(char *textstring)
+    {
+    outtextxy(Pos_x, Pos_y, textstring);
+    }
+
+
+// Bresenham, as SDL_bgi.
+void line(int x1, int y1, int x2, int y2)
+    {
+    int dx = abs(x2 - x1), sx = (x1 < x2) ? 1 : -1;
+    int dy = -abs(y2 - y1), sy = (y1 < y2) ? 1 : -1;
+    int err = dx + dy, e2;
+
+    while (1)
+        {
+        PutPixel(x1, y1, Color);
+        if (x1 == x2 && y1 == y2)
+            {
+            break;
+            }
+        e2 = 2 * err;
+        if (e2 >= dy)
+            {
+            err += dy;
+            x1 += sx;
+            }
+        if (e2 <= dx)
+            {
+            err += dx;
+            y1 += sy;
+            }
+        }
+    }
+
+
+// Midpoint circle.
+void circle(int x, int y, int radius)
+    {
+    int px = radius, py = 0, err = 1 - radius;
+
+    while (px >= py)
+        {
+        PutPixel(x + px, y + py, Color);
+        PutPixel(x + py, y + px, Color);
+        PutPixel(x - py, y + px, Color);
+        PutPixel(x - px, y + py, Color);
+        PutPixel(x - px, y - py, Color);
+        PutPixel(x - py, y - px, Color);
+        PutPixel(x + py, y - px, Color);
+        PutPixel(x + px, y - py, Color);
+        py++;
+        if (err < 0)
+            {
+            err += 2 * py + 1;
+            }
+        else
+            {
+            px--;
+            err += 2 * (py - px) + 1;
+            }
+        }
+    }
+
+
+void bar(int left, int top, int right, int bottom)
+    {
+    int x, y;
+
+    for (y = top; y <= bottom; y++)
+        {
+        for (x = left; x <= right; x++)
+            {
+            PutPixel(x, y, Fill_color);
+            }
+        }
+    }
+
+
+// SDL_bgi doesn't clip here. A pixel off the page would be written past the
+// page (or into the next row), so it is counted instead.
+void fputpixel(int x, int y)
+    {
+    HeadlessWindow *w = &Win[Cur];
+
+    if (x < 0 || y < 0 || x >= w->width || y >= w->height)
+        {
+        Off_page++;
+        return;
+        }
+    PutPixel(x, y, Color);
+    }
+
+
+//==============================================================================
+// Benchmarks
+
+static double Seconds(void)
+    {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+
+// The hand tables of the clock before HandPoint(), copied unchanged from it.
+// calcPoints() for the hour hand, minSecCalc() for the minute hand and
+// Calc3600() for the second hand.
+static void calcPoints(int radius, int midx, int midy, int x[12], int y[12])
+    {
+    int x1, y1;
+
+    /* 90, 270, 0, 180 degrees */
+    x[0] = midx, y[0] = midy - radius;
+    x[6] = midx, y[6] = midy + radius;
+    x[3] = midx + radius, y[3] = midy;
+    x[9] = midx - radius, y[9] = midy;
+
+    /* 30, 150, 210, 330 degrees */
+    x1 = (int) ((radius / 2) * sqrt(3));
+    y1 = (radius / 2);
+    x[2] = midx + x1, y[2] = midy - y1;
+    x[4] = midx + x1, y[4] = midy + y1;
+    x[8] = midx - x1, y[8] = midy + y1;
+    x[10] = midx - x1, y[10] = midy - y1;
+
+    /* 60, 120, 210, 300 degrees */
+    x1 = radius / 2;
+    y1 = (int) ((radius / 2)  * sqrt(3));
+    x[1] = midx + x1, y[1] = midy - y1;
+    x[5] = midx + x1, y[5] = midy + y1;
+    x[7] = midx - x1, y[7] = midy + y1;
+    x[11] = midx - x1, y[11] = midy - y1;
+
+    return;
+    }
+
+
+static void minSecCalc(int radius, int midx, int midy, int secx[60], int secy[60])
+    {
+    //int i, j = 0, x, y;
+    int i, j = 0;
+    //char str[32];
+
+    /* 15 position(min/sec - 12 to 3) in first quadrant of clock  */
+    secx[j] = midx, secy[j++] = midy - radius;
+
+    for (i = 96; i < 180; i = i + 6)
+        {
+        secx[j] = midx - (radius * cos((i * 3.14) / 180));
+        secy[j++] = midy - (radius * sin((i * 3.14) / 180));
+        }
+
+    /* 15 positions(min or sec - 3 to 6) in second quadrant of clock */
+    secx[j] = midx + radius, secy[j++] = midy;
+    for (i = 186; i < 270; i = i + 6)
+        {
+        secx[j] = midx - (radius * cos((i * 3.14) / 180));
+        secy[j++] = midy - (radius * sin((i * 3.14) / 180));
+        }
+
+    /* 15 positions(min or sec - 6 to 9) in third quadrant of clock */
+    secx[j] = midx, secy[j++] = midy + radius;
+    for (i = 276; i < 360; i = i + 6)
+        {
+        secx[j] = midx - (radius * cos((i * 3.14) / 180));
+        secy[j++] = midy - (radius * sin((i * 3.14) / 180));
+        }
+
+    /* 15 positions(min or sec - 9 to 12) in fourth quadrant of clock */
+    secx[j] = midx - radius, secy[j++] = midy;
+    for (i = 6; i < 90; i = i + 6)
+        {
+        secx[j] = midx - (radius * cos((i * 3.14) / 180));
+        secy[j++] = midy - (radius * sin((i * 3.14) / 180));
+        }
+
+    return;
+    }
+
+
+static void Calc3600(int radius, int midx, int midy, int secx[3600], int secy[3600])
+    {
+    //int i, j = 0, x, y;
+    int i, j = 0;
+    //char str[32];
+
+    /* 90 position(min/sec - 12 to 3) in first quadrant of clock  */
+    secx[j] = midx, secy[j++] = midy - radius;
+    for (i = 901; i < 1800; i = i + 1)  // +6
+        {
+        secx[j] = midx - (radius * cos((i * 3.14) / 1800));
+        secy[j++] = midy - (radius * sin((i * 3.14) / 1800));
+        }
+
+    /* 90 positions(min or sec - 3 to 6) in second quadrant of clock */
+    secx[j] = midx + radius, secy[j++] = midy;
+    for (i = 1801; i < 2700; i = i + 1)  // +6
+        {
+        secx[j] = midx - (radius * cos((i * 3.14) / 1800));
+        secy[j++] = midy - (radius * sin((i * 3.14) / 1800));
+        }
+
+    /* 90 positions(min or sec - 6 to 9) in third quadrant of clock */
+    secx[j] = midx, secy[j++] = midy + radius;
+    for (i = 2701; i < 3600; i = i + 1)  // +6
+        {
+        secx[j] = midx - (radius * cos((i * 3.14) / 1800));
+        secy[j++] = midy - (radius * sin((i * 3.14) / 1800));
+        }
+
+    /* 90 positions(min or sec - 9 to 12) in fourth quadrant of clock */
+    secx[j] = midx - radius, secy[j++] = midy;
+    for (i = 1; i < 900; i = i + 1)  // +6
+        {
+        secx[j] = midx - (radius * cos((i * 3.14) / 1800));
+        secy[j++] = midy - (radius * sin((i * 3.14) / 1800));
+        }
+
+    }
+
+
+// The hand engine for the default 1410x1010 window. Each simulated frame
+// places the hour, minute and second hands once, first from the old 12, 60
+// and 3600 point tables (the hour and minute hands jump) and then with
+// HandPoint() (they follow the seconds). Then each point of the old tables is
+// compared with HandPoint() at the same tick. The old minute and second tables
+// used 3.14 for pi, which put their points up to 0.18 degrees off the true
+// angle (1.6 px at radius 500), and the hour table halved the radius in int.
+static int BenchHands(void)
+    {
+    int radius = 500, midx = 704, midy = 504;
+    int length[3] = {radius - 100, radius - 70, radius};
+    int count[3] = {12, 60, CLOCK_TICKS};
+    const char *name[3] = {"Hour", "Minute", "Second"};
+    static int hrx[12], hry[12], minx[60], miny[60], secx[CLOCK_TICKS], secy[CLOCK_TICKS];
+    int *tablex[3] = {hrx, minx, secx};
+    int *tabley[3] = {hry, miny, secy};
+    volatile int sink = 0;
+    double t0, t_table, t_engine, min_phase;
+    int i, j, x, y, diff, max_diff, differ;
+    long long n;
+
+    CalcUnitCircle();
+    calcPoints(length[0], midx, midy, hrx, hry);
+    minSecCalc(length[1], midx, midy, minx, miny);
+    Calc3600(length[2], midx, midy, secx, secy);
+
+    t0 = Seconds();
+    for (n = 0; n < HEADLESS_BENCH_FRAMES; n++)
+        {
+        i = n % 12;
+        sink += hrx[i] + hry[i];
+        i = (n >> 3) % 60;
+        sink += minx[i] + miny[i];
+        i = n % CLOCK_TICKS;
+        sink += secx[i] + secy[i];
+        }
+    t_table = Seconds() - t0;
+
+    t0 = Seconds();
+    for (n = 0; n < HEADLESS_BENCH_FRAMES; n++)
+        {
+        min_phase = ((n >> 3) % 60) + ((n % 60) / 60.0);
+        HandPoint(((n % 12) + (min_phase / 60.0)) / 12.0, length[0], midx, midy, &x, &y);
+        sink += x + y;
+        HandPoint(min_phase / 60.0, length[1], midx, midy, &x, &y);
+        sink += x + y;
+        HandPoint((double)(n % CLOCK_TICKS) / CLOCK_TICKS, length[2], midx, midy, &x, &y);
+        sink += x + y;
+        }
+    t_engine = Seconds() - t0;
+
+    printf("Hands, radius %d, %d frames\n", radius, HEADLESS_BENCH_FRAMES);
+    printf("Table lookups:   %.2f ns per frame\n", t_table * 1e9 / HEADLESS_BENCH_FRAMES);
+    printf("HandPoint() x 3: %.2f ns per frame\n", t_engine * 1e9 / HEADLESS_BENCH_FRAMES);
+    printf("HandPoint() against the old tables at each tick (dx + dy):\n");
+    for (j = 0; j < 3; j++)
+        {
+        max_diff = 0;
+        differ = 0;
+        for (i = 0; i < count[j]; i++)
+            {
+            HandPoint((double)i / count[j], length[j], midx, midy, &x, &y);
+            diff = abs(x - tablex[j][i]) + abs(y - tabley[j][i]);
+            differ += (diff != 0);
+            max_diff = (diff > max_diff) ? diff : max_diff;
+            }
+        printf("%-6s %3d px: %4d of %4d points differ, by up to %d px\n",
+               name[j], length[j], differ, count[j], max_diff);
+        }
+    return 0;
+    }
+
+
+// The plain TD path as the clock's frame loop has it with CLOCK_PRECISE_TD 0.
+__attribute__((noinline))
+static void TdPhasePlain(const double *velocity, int radii, int ticks, int *phase)
+    {
+    double time_accumulative;
+    int time_accumulative_temp, adjust3600;
+    int i;
+
+    for (i = 0; i < radii; i++)
+        {
+        time_accumulative = ((GetTimeDilation(velocity[i]) / 60.0) * ticks);
+        time_accumulative_temp = round(((time_accumulative) * 0.6) * 100);
+        adjust3600 = (int)(time_accumulative_temp / 3600);
+        if (time_accumulative_temp >= 1)
+            {
+            time_accumulative_temp -= (3600 * adjust3600);
+            }
+        phase[i] = time_accumulative_temp;
+        }
+    }
+
+
+// The same loop with GetTimeDilation() / 60.0 taken out and worked once per
+// radius point, as the precise path has its rates. This is the like for like
+// cost to hold the precise path against.
+__attribute__((noinline))
+static void TdPhasePlainRate(const double *rate, int radii, int ticks, int *phase)
+    {
+    double time_accumulative;
+    int time_accumulative_temp, adjust3600;
+    int i;
+
+    for (i = 0; i < radii; i++)
+        {
+        time_accumulative = rate[i] * ticks;
+        time_accumulative_temp = round(((time_accumulative) * 0.6) * 100);
+        adjust3600 = (int)(time_accumulative_temp / 3600);
+        if (time_accumulative_temp >= 1)
+            {
+            time_accumulative_temp -= (3600 * adjust3600);
+            }
+        phase[i] = time_accumulative_temp;
+        }
+    }
+
+
+// The reference rate of radius point i. 1 - v/C is taken as the double the
+// clock works from, the rest is in __float128 (113 bits, past the 106 of the
+// double-double path).
+static __float128 TdRateReference(double band, int radii, int i)
+    {
+    __float128 one_minus = band * ((double)(radii - 1 - i) / radii);
+
+    return sqrtq(one_minus * (2 - one_minus));
+    }
+
+
+// The TD tables the clock builds for a zoom level. The clock only builds the
+// ones for its CLOCK_PRECISE_TD setting, so both are worked out here the same
+// way: velocity[] as BuildGeometry() (level 0) and GetZoomBand() do with
+// CLOCK_PRECISE_TD 0, and the rates with the clock's CalcRatePrecise().
+static void TdTables(int level, int radii, double *velocity, double *rate_hi,
+                     double *rate_lo)
+    {
+    double band = (level == 0) ? 1.0 : pow(10.0, -level);
+    int i;
+
+    for (i = 0; i < radii; i++)
+        {
+        if (level == 0)
+            {
+            velocity[i] = (6.28318530717958647692 * ((CLOCK_RADIUS_M / radii) * (i + 1)) / 60);
+            }
+        else
+            {
+            velocity[i] = CLOCK_C * (1.0 - band * ((double)(radii - 1 - i) / radii));
+            }
+        }
+    CalcRatePrecise(band, radii, rate_hi, rate_lo);
+    }
+
+
+// Throughput of both paths over HEADLESS_BENCH_POINTS radius points, the plain
+// path both as the clock has it and with its rates worked out up front, then
+// the error of each against the reference. The tick counts run from the first
+// minute to the INT_MAX - 7200 the clock's counters can reach.
+static int BenchTd(void)
+    {
+    static const int radii_list[2] = {500, 4000};
+    static const int ticks_list[4] = {3599, 3600 * 60 * 24, 3600 * 60 * 24 * 30, INT_MAX - 7200};
+    double *velocity, *rate_hi, *rate_lo, *rate_plain;
+    int *phase_plain, *phase_precise;
+    volatile long long sink = 0;
+    double t0, t_plain, t_plain_rate, t_precise, band, err, err_plain, err_precise;
+    __float128 ref, ref_ticks;
+    long long mis_plain, mis_precise, mis_total = 0;
+    int r, radii, level, iters, it, i, k, ref_phase;
+
+    for (r = 0; r < 2; r++)
+        {
+        radii = radii_list[r];
+        iters = HEADLESS_BENCH_POINTS / radii;
+        phase_plain = (int*)malloc(radii * sizeof(int));
+        phase_precise = (int*)malloc(radii * sizeof(int));
+        velocity = (double*)malloc(radii * sizeof(double));
+        rate_hi = (double*)malloc(radii * sizeof(double));
+        rate_lo = (double*)malloc(radii * sizeof(double));
+        rate_plain = (double*)malloc(radii * sizeof(double));
+        if (phase_plain == NULL || phase_precise == NULL || velocity == NULL ||
+            rate_hi == NULL || rate_lo == NULL || rate_plain == NULL)
+            {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+            }
+        TdTables(0, radii, velocity, rate_hi, rate_lo);
+        for (i = 0; i < radii; i++)
+            {
+            rate_plain[i] = GetTimeDilation(velocity[i]) / 60.0;
+            }
+
+        t0 = Seconds();
+        for (it = 0; it < iters; it++)
+            {
+            TdPhasePlain(velocity, radii, (3600 * 60) + it, phase_plain);
+            sink += phase_plain[it % radii];
+            }
+        t_plain = Seconds() - t0;
+
+        t0 = Seconds();
+        for (it = 0; it < iters; it++)
+            {
+            TdPhasePlainRate(rate_plain, radii, (3600 * 60) + it, phase_plain);
+            sink += phase_plain[it % radii];
+            }
+        t_plain_rate = Seconds() - t0;
+
+        t0 = Seconds();
+        for (it = 0; it < iters; it++)
+            {
+            TdPhasePrecise(rate_hi, rate_lo, radii, (3600 * 60) + it, phase_precise);
+            sink += phase_precise[it % radii];
+            }
+        t_precise = Seconds() - t0;
+
+        printf("TD hand, %d radius points\n", radii);
+        printf("Plain:             %.2f ns per point (GetTimeDilation() each point)\n",
+               t_plain * 1e9 / ((double)iters * radii));
+        printf("Plain, rates kept: %.2f ns per point\n",
+               t_plain_rate * 1e9 / ((double)iters * radii));
+        printf("Precise:           %.2f ns per point (%.2fx plain with rates kept)\n",
+               t_precise * 1e9 / ((double)iters * radii), t_precise / t_plain_rate);
+        printf("Level  Max rate error (plain / precise)  Phase mismatches (plain / precise)\n");
+
+        for (level = 0; level <= CLOCK_ZOOM_MAX; level++)
+            {
+            TdTables(level, radii, velocity, rate_hi, rate_lo);
+            band = (level == 0) ? 1.0 : pow(10.0, -level);
+            err_plain = 0;
+            err_precise = 0;
+            mis_plain = 0;
+            mis_precise = 0;
+
+            for (i = 0; i < radii; i++)
+                {
+                // Relative error, or absolute at the outer point where the
+                // reference is 0.
+                ref = TdRateReference(band, radii, i);
+                err = (double)fabsq(GetTimeDilation(velocity[i]) - ref);
+                err_plain = fmax(err_plain, (ref > 0) ? err / (double)ref : err);
+                err = (double)fabsq(((__float128)rate_hi[i] + rate_lo[i]) - ref);
+                err_precise = fmax(err_precise, (ref > 0) ? err / (double)ref : err);
+                }
+
+            for (k = 0; k < 4; k++)
+                {
+                TdPhasePlain(velocity, radii, ticks_list[k], phase_plain);
+                TdPhasePrecise(rate_hi, rate_lo, radii, ticks_list[k], phase_precise);
+                for (i = 0; i < radii; i++)
+                    {
+                    ref_ticks = TdRateReference(band, radii, i) * ticks_list[k];
+                    ref_phase = (int)((long long)floorq(ref_ticks + 0.5Q) % CLOCK_TICKS);
+                    mis_plain += (phase_plain[i] != ref_phase);
+                    mis_precise += (phase_precise[i] != ref_phase);
+                    }
+                }
+
+            printf("%5d  %14.3e / %-14.3e      %8lld / %lld of %d\n", level,
+                   err_plain, err_precise, mis_plain, mis_precise, radii * 4);
+            mis_total += mis_precise;
+            }
+
+        free(phase_plain);
+        free(phase_precise);
+        free(velocity);
+        free(rate_hi);
+        free(rate_lo);
+        free(rate_plain);
+        }
+
+    return (mis_total == 0) ? 0 : 2;
+    }
+
+
+//==============================================================================
+
+static int ParseKey(const char *arg)
+    {
+    HeadlessKey *k = &Keys[Key_count];
+    char name[16];
+
+    if (Key_count == HEADLESS_KEYS ||
+        sscanf(arg, "%lld:%15s", &k->frame, name) != 2)
+        {
+        return 0;
+        }
+    k->close = 0;
+    if (strcmp(name, "shift") == 0) k->key = SDLK_LSHIFT;
+    else if (strcmp(name, "ctrl") == 0) k->key = SDLK_LCTRL;
+    else if (strcmp(name, "alt") == 0) k->key = SDLK_LALT;
+    else if (strcmp(name, "kp+") == 0) k->key = SDLK_KP_PLUS;
+    else if (strcmp(name, "kp-") == 0) k->key = SDLK_KP_MINUS;
+    else if (strcmp(name, "esc") == 0) k->key = SDLK_ESCAPE;
+    else if (strcmp(name, "close") == 0) k->close = 1;
+    else if (strlen(name) == 1) k->key = (unsigned char)name[0];
+    else return 0;
+    Key_count++;
+    return 1;
+    }
+
+
+int main(int argc, char *argv[])
+    {
+    double seconds;
+    int i, ret;
+
+    for (i = 1; i < argc; i++)
+        {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            {
+            Max_frames = atoll(argv[++i]);
+            }
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            {
+            if (sscanf(argv[++i], "%dx%d", &Desktop_w, &Desktop_h) != 2)
+                {
+                fprintf(stderr, "-d takes WxH\n");
+                return 1;
+                }
+            }
+        else if (strcmp(argv[i], "-c") == 0)
+            {
+            Check = 1;
+            }
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+            {
+            if (!ParseKey(argv[++i]))
+                {
+                fprintf(stderr, "-k takes frame:key\n");
+                return 1;
+                }
+            }
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc &&
+                 strcmp(argv[i + 1], "hands") == 0)
+            {
+            return BenchHands();
+            }
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc &&
+                 strcmp(argv[i + 1], "td") == 0)
+            {
+            return BenchTd();
+            }
+        else
+            {
+            fprintf(stderr, "Usage: %s [-n frames] [-d WxH] [-c] [-k frame:key]...\n"
+                            "       %s -b hands|td\n", argv[0], argv[0]);
+            return 1;
+            }
+        }
+
+    ret = ClockMain(1, argv);
+
+    seconds = (End_ts.tv_sec - Start_ts.tv_sec) + (End_ts.tv_nsec - Start_ts.tv_nsec) / 1e9;
+    printf("Frames:          %lld (%.1f us per frame)\n", Frames,
+           (Frames > 1) ? seconds * 1e6 / (Frames - 1) : 0.0);
+    printf("Uploaded:        %lld KiB per frame (%lld full refreshes)\n",
+           (Frames > 0) ? Upload_bytes / Frames / 1024 : 0, Full_refreshes);
+    if (Check)
+        {
+        printf("Mismatches:      %lld frames\n", Mismatches);
+        }
+    printf("Off page pixels: %lld\n", Off_page);
+
+    if (ret != 0 || Mismatches != 0 || Off_page != 0)
+        {
+        return 2;
+        }
+    return 0;
+    }
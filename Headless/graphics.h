@@ -0,0 +1,154 @@
+//------------------------------------------------------------------------------
+// Name:        graphics.h (headless)
+// Purpose:     Stand in for the SDL_bgi <graphics.h> so the clock can be run
+//              and measured without a display.
+// Title:       "Time Dilation Clock - headless SDL_bgi"
+//
+// Platform:    Ubuntu64
+//
+// Compiler:    GCC V9.x.x (ISO C99)
+// Depends:     SDL-BGI_Clock_T-D_headless.c
+//
+// Author:      Axle
+// Licence:     MIT
+//------------------------------------------------------------------------------
+// NOTES:
+// Only the part of the SDL_bgi 3.0.0 (and SDL2) API that the clock uses is
+// declared here, with the same names, values and behaviour. Drawing goes to
+// plain ARGB pages in memory. See SDL-BGI_Clock_T-D_headless.c.
+//------------------------------------------------------------------------------
+
+#ifndef CLOCK_HEADLESS_GRAPHICS_H
+#define CLOCK_HEADLESS_GRAPHICS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// SDL2
+typedef uint8_t Uint8;
+typedef uint32_t Uint32;
+typedef int32_t SDL_Keycode;
+
+typedef struct
+    {
+    int x, y;
+    int w, h;
+    } SDL_Rect;
+
+typedef struct
+    {
+    SDL_Keycode sym;
+    uint16_t mod;
+    } SDL_Keysym;
+
+typedef struct
+    {
+    Uint32 type;
+    Uint32 timestamp;
+    Uint32 windowID;
+    Uint8 state;
+    Uint8 repeat;
+    SDL_Keysym keysym;
+    } SDL_KeyboardEvent;
+
+typedef struct
+    {
+    Uint32 type;
+    Uint32 timestamp;
+    Uint32 windowID;
+    Uint8 event;
+    } SDL_WindowEvent;
+
+typedef union
+    {
+    Uint32 type;
+    SDL_KeyboardEvent key;
+    SDL_WindowEvent window;
+    } SDL_Event;
+
+#define SDL_QUIT 0x100
+#define SDL_WINDOWEVENT 0x200
+#define SDL_KEYDOWN 0x300
+#define SDL_WINDOWEVENT_CLOSE 14
+
+#define SDLK_SCANCODE_MASK (1 << 30)
+#define SDLK_ESCAPE 27
+#define SDLK_CAPSLOCK (57 | SDLK_SCANCODE_MASK)
+#define SDLK_NUMLOCKCLEAR (83 | SDLK_SCANCODE_MASK)
+#define SDLK_KP_MINUS (86 | SDLK_SCANCODE_MASK)
+#define SDLK_KP_PLUS (87 | SDLK_SCANCODE_MASK)
+#define SDLK_LCTRL (224 | SDLK_SCANCODE_MASK)
+#define SDLK_LSHIFT (225 | SDLK_SCANCODE_MASK)
+#define SDLK_LALT (226 | SDLK_SCANCODE_MASK)
+#define SDLK_LGUI (227 | SDLK_SCANCODE_MASK)
+#define SDLK_RCTRL (228 | SDLK_SCANCODE_MASK)
+#define SDLK_RSHIFT (229 | SDLK_SCANCODE_MASK)
+#define SDLK_RALT (230 | SDLK_SCANCODE_MASK)
+#define SDLK_RGUI (231 | SDLK_SCANCODE_MASK)
+#define SDLK_MODE (257 | SDLK_SCANCODE_MASK)
+
+typedef struct SDL_Texture SDL_Texture;
+typedef struct SDL_Renderer SDL_Renderer;
+
+#define SDL_WINDOWPOS_CENTERED 0x2FFF0000u
+#define SDL_WINDOW_FULLSCREEN 0x00000001u
+#define SDL_WINDOW_SHOWN 0x00000004u
+#define SDL_WINDOW_HIDDEN 0x00000008u
+#define SDL_WINDOW_BORDERLESS 0x00000010u
+#define SDL_WINDOW_MINIMIZED 0x00000040u
+#define SDL_WINDOW_MAXIMIZED 0x00000080u
+#define SDL_WINDOW_FULLSCREEN_DESKTOP (SDL_WINDOW_FULLSCREEN | 0x00001000u)
+
+int SDL_UpdateTexture(SDL_Texture *texture, const SDL_Rect *rect,
+                      const void *pixels, int pitch);
+int SDL_RenderCopy(SDL_Renderer *renderer, SDL_Texture *texture,
+                   const SDL_Rect *srcrect, const SDL_Rect *dstrect);
+void SDL_RenderPresent(SDL_Renderer *renderer);
+void SDL_Delay(Uint32 ms);
+int SDL_PollEvent(SDL_Event *event);
+
+// SDL_bgi
+enum { BLACK, BLUE, GREEN, CYAN, RED, MAGENTA, BROWN, LIGHTGRAY, DARKGRAY,
+       LIGHTBLUE, LIGHTGREEN, LIGHTCYAN, LIGHTRED, LIGHTMAGENTA, YELLOW, WHITE };
+enum { SOLID_LINE = 0 };
+enum { EMPTY_FILL = 0, SOLID_FILL = 1 };
+enum { DEFAULT_FONT = 0, TRIPLEX_FONT = 1 };
+enum { LEFT_TEXT = 0, CENTER_TEXT = 1, RIGHT_TEXT = 2 };
+
+extern SDL_Texture *bgi_texture;
+extern SDL_Renderer *bgi_renderer;
+extern Uint32 *bgi_activepage[];
+
+void setwinoptions(char *title, int x, int y, Uint32 flags);
+void resetwinoptions(int id, char *title, int x, int y);
+int initwindow(int width, int height);
+void closewindow(int id);
+void setcurrentwindow(int id);
+void closegraph(void);
+void sdlbgifast(void);
+int getmaxx(void);
+int getmaxy(void);
+void refresh(void);
+void cleardevice(void);
+int getvisualpage(void);
+int getactivepage(void);
+void setvisualpage(int page);
+void setactivepage(int page);
+
+void setcolor(int color);
+void setfillstyle(int pattern, int color);
+void setlinestyle(int linestyle, unsigned upattern, int thickness);
+void settextstyle(int font, int direction, int charsize);
+void settextjustify(int horiz, int vert);
+int textwidth(char *textstring);
+int textheight(char *textstring);
+void outtextxy(int x, int y, char *textstring);
+void moveto(int x, int y);
+void outtext(char *textstring);
+void line(int x1, int y1, int x2, int y2);
+void circle(int x, int y, int radius);
+void bar(int left, int top, int right, int bottom);
+void fputpixel(int x, int y);
+
+#endif  // CLOCK_HEADLESS_GRAPHICS_H
@@ -6,9 +6,12 @@
 // Platform:    Win64, Ubuntu64
 //
 // Compiler:    GCC V9.x.x, MinGw-64, libc (ISO C99)
+//              -O3 -march=native (or -mfma) lets GCC vectorize the precise TD
+//              phase loop with hardware fma.
 // Depends:     SDL2-devel, SDL_bgi-3.0.0,
-// Requires:    Minimum screen resolution of 1410x1010 for the clock window.
-//              ie. 1920 x 1080 (FHD)
+//              SDL-BGI_Clock_T-D_shm.h (POSIX shm_open, link -lrt on old glibc)
+// Requires:    pthreads (MinGW-64 winpthreads on Windows).
+//              Any screen resolution, the clock is scaled to the window.
 //
 // Author:      Axle
 // Created:     12/03/2023
@@ -47,10 +50,28 @@
 // table. Each period of dilation is calculated for the current clock time for
 // the 500 positions of radius against the time when the clock app started.
 //
+// The clock face is sized from the current window (500px radius in the default
+// 1410x1010 window) and the number of radius points follows the radius in
+// pixels. The TD look up tables are scaled from one unit circle table. When the
+// window size changes the new tables are built on a background thread and
+// swapped in whole, the old tables keep rendering until then.
+//
+// The hour, minute and second hands are all drawn by the one hand engine,
+// HandPoint(), from a continuous phase (0.0 to 1.0 of a rotation) against the
+// same unit circle table. The hour and minute hands move smoothly rather than
+// jumping each hour and minute.
+//
 // Although some amount of accumulated error occurs over time due to the size
 // limitations of the floating point precision I don't think this would be
 // recognisable at the scale of the clock with a 1000 pixel diameter.
 //
+// Near C that is no longer true. 1 - (v/C)^2 cancels to nothing as v/C gets
+// close to 1 and the zoomed in radius points turn to noise. CLOCK_PRECISE_TD
+// works the dilation from (1 - v/C) directly as (1 - v/C)(1 + v/C), with no
+// subtraction of near equal values, and holds the rate for each radius point
+// and the rate * ticks product as double-double (a pair of doubles, hi + lo)
+// so the phase stays correct to the tick however long the clock runs.
+//
 // The clock is calculated to a precision of 60 frames per second. In practice
 // the clock may update at a faster or slower FPS, but overall accuracy remains.
 // 3600 points are calculated for the circumference of the clock or 60 seconds
@@ -65,6 +86,22 @@
 // real world (physical structure) the forces applied to the second hand would
 // tear it away from its central axis long before reaching the speed of light.
 //
+// The current clock state (hand positions, TD phase for each radius and frame
+// timings) is published each frame to a POSIX shared memory segment guarded by
+// a seqlock. See SDL-BGI_Clock_T-D_shm.h and SDL-BGI_Clock_T-D_shm_reader.c.
+//
+// Only the needles, the TD plots and the stats change from frame to frame. With
+// CLOCK_DAMAGE_TRACKING the clock remembers what it drew in the last frame and
+// erases just that (rather than cleardevice() of the whole window), and only the
+// 32x32 pixel tiles that changed are copied to the screen texture. The stats
+// show the bytes cleared and presented each frame for either path.
+//
+// The '+' and '-' keys zoom the TD hand into the band of velocity closest to
+// C, where the time dilation changes the most. Zoom level n spreads the band
+// (1 - 10^-n)c to 1c over the full radius, so level 2 shows 0.99c to 1c with
+// every pixel of radius as its own radius point. The TD tables for each
+// level are cached so going back and forth between levels is instant.
+//
 // The SDL_Bgi library is quite limited, so in all likelihood I will migrate
 // the Time Dilation Clock to a more capable graphics library in the future.
 //------------------------------------------------------------------------------
@@ -87,43 +124,220 @@
 #include <limits.h>
 #include <float.h>
 
+// To publish the live clock state to shared memory for other local processes.
+#ifndef _WIN32
+#define CLOCK_SHM_PUBLISH 1 // 1 == ON | 0 == OFF
+#else
+#define CLOCK_SHM_PUBLISH 0 // POSIX shared memory is not available.
+#endif
+
+#if CLOCK_SHM_PUBLISH == 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <errno.h>
+#include "SDL-BGI_Clock_T-D_shm.h"
+#endif
+
+#include <pthread.h>
+
 // Turn off compiler warnings for unused variables between (Windows/Linux etc.)
 #define unused(x) (x) = (x)
-// The following dimentions are currently hard coded to a 1000 pixel diameter
-// clock face and cannot be altered. I may add screen dimension scaling/resizing
-// in the future.
+// The default window size (1000 pixel diameter clock face). The clock face and
+// all of the look up tables are sized from the current window.
 #define WINDOW_X 1410
 #define WINDOW_Y 1010
 
+// To start the clock full screen at the desktop resolution. 'F' switches
+// between the window and full screen while running.
+#define CLOCK_FULLSCREEN 0 // 1 == ON | 0 == OFF
+
+// Points around the circumference. 60 sec * 60 ticks (60 FPS).
+#define CLOCK_TICKS 3600
+
+// The full scale radius of the clock in meters. Circumference / 60 == C.
+#define CLOCK_RADIUS_M 2862807095.5421653553357478091848
+
+// Speed of light 'c' in m/s.
+#define CLOCK_C 299792458.0
+
+// Deepest zoom level, (1 - 10^-12)c to 1c. Past this the plain TD path
+// (CLOCK_PRECISE_TD 0) can't tell the radius points apart, as v near C only
+// has steps of about 6e-8 m/s in double. The precise path works from 1 - v/C
+// and would stay exact far deeper, the cap is kept for both so they show the
+// same bands.
+#define CLOCK_ZOOM_MAX 12
+
+// Number of zoom tables kept, one per zoom level and window size, the least
+// recently used is replaced. This keeps the tables of the last few levels
+// and of the other window (F) without rebuilding them. Level 0 is part of the
+// ClockGeometry and is not cached.
+#define CLOCK_ZOOM_CACHE 8
+
 // To add or remove the numerals from the clock face.
 #define CLOCK_NUMERALS 0 // 1 == ON | 0 == OFF
 
-// Separate implementations of the x. y rendering functions.
-// I have left both sets so you can see what I have done to
-// calculate 3600 second hand tics per minute :)
-// 3600 (/60 sec) == 60 frames per second for rendering the second hand.
-// for 30 frames per second we would make secx/y[1800]
-void Calc3600(int radius, int midx, int midy, int secx[3600], int secy[3600]);
+// Evaluate the TD hand with the cancellation free double-double path rather
+// than sqrt(1 - (v/C)^2) in plain double.
+#define CLOCK_PRECISE_TD 1 // 1 == ON | 0 == OFF
 
-// Calculate the x,y for the time dilation hand. 3600 possitions of circumference.
-void Calc3600_td(int radius, int midx, int midy, int **secx, int **secy);
-//==============================================================================
-// http://see-programming.blogspot.com/2013/09/c-program-to-implement-analog-clock.html
-// Calculate numbers Hours and Minutes.
-void minSecCalc(int radius, int midx, int midy, int secx[60], int secy[60]);
-void calcPoints(int radius, int midx, int midy, int x[12], int y[23]);
+// Erase and present only what changed each frame rather than the full window.
+#define CLOCK_DAMAGE_TRACKING 1 // 1 == ON | 0 == OFF
+
+// Size of the damage tiles in pixels.
+#define CLOCK_DAMAGE_TILE 32
 
-// Not currently in use. This is required as part of a standard clock with
-// 1 second ticks
-void Calc360(int radius, int midx, int midy, int secx[60], int secy[60]);
+// All of the window size dependent clock data. A complete new set is built
+// whenever the window size changes and replaces the old set in one step.
+typedef struct
+    {
+    int width, height;  // getmaxx() + 1, getmaxy() + 1
+    int midx, midy;
+    int radius;  // Clock face radius in pixels.
+    int radii;  // Radius plots for the TD hand (1 per pixel of radius).
+#if CLOCK_PRECISE_TD == 1
+    double *rate_hi, *rate_lo;  // [radii] TD rate at each radius point (hi + lo).
+    int *td_phase;  // [radii] TD hand tick position at each radius point.
+#else
+    double *velocity;  // [radii] m/s at each radius point.
+#endif
+    int *td_plotx, *td_ploty;  // [radii * CLOCK_TICKS] TD hand x.y plots.
+    } ClockGeometry;
+
+// The TD tables for one zoom level. The plot positions are shared with the
+// ClockGeometry as each zoom band is spread over the same radius points.
+typedef struct
+    {
+    int level;  // 0 == empty (zoom level 0 uses the ClockGeometry tables).
+    int radii;
+    unsigned long long used;  // Frame of last use, for least recently used.
+#if CLOCK_PRECISE_TD == 1
+    double *rate_hi, *rate_lo;  // [radii] TD rate at each radius point (hi + lo).
+#else
+    double *velocity;  // [radii] m/s at each radius point.
+#endif
+    } ZoomCacheEntry;
+
+#if CLOCK_DAMAGE_TRACKING == 1
+// What was drawn in the last frame, so it can be erased exactly, and the tiles
+// of the window that have changed since the last present.
+typedef struct
+    {
+    int valid;  // 0 == the next frame needs a full clear and present.
+    int width, height;
+    int midx, midy;
+    int hand_x[3], hand_y[3];  // Hour, minute and second needle end points.
+    int td_count;
+    int *td_x, *td_y;  // [radii] TD plots drawn.
+    int stats_w, stats_h;  // Stats panel from 0,0.
+    int cols, rows;
+    unsigned char *tiles;  // [cols * rows] 1 == changed since the last present.
+    } ClockDamage;
+#endif
+
+// Calculate the CLOCK_TICKS x,y points of a circle of radius 1 starting at 12
+// o'clock. All other clock tables and hands are scaled from this.
+void CalcUnitCircle(void);
+
+// The hand engine. Get the x,y end point of a hand of length pixels at phase
+// (0.0 to 1.0 of a full rotation from 12 o'clock).
+void HandPoint(double phase, int length, int midx, int midy, int *x, int *y);
+
+// Scale the CLOCK_TICKS points of the unit circle to radius.
+void ScaleUnitCircle(int radius, int midx, int midy, int *secx, int *secy);
+
+// Open the clock window, full screen at the desktop size or WINDOW_X x WINDOW_Y.
+// Returns the SDL_bgi window ID.
+int OpenClockWindow(int fullscreen);
+
+// Build (and free) the complete set of clock tables for a window size.
+ClockGeometry *BuildGeometry(int width, int height);
+void FreeGeometry(ClockGeometry *geo);
+
+// Build a new ClockGeometry on a background thread. The result is handed
+// back through Pending_geo. Returns 0 if the thread could not be started.
+int StartGeometryBuild(int width, int height);
+void *GeometryBuildThread(void *arg);
+
+// Get the TD tables for a zoom level (the rates, or the velocity with
+// CLOCK_PRECISE_TD 0), from the cache or calculated and added to it. Returns
+// NULL if out of memory.
+ZoomCacheEntry *GetZoomBand(ZoomCacheEntry cache[CLOCK_ZOOM_CACHE], int level,
+                            int radii, unsigned long long frame);
+void FreeZoomCache(ZoomCacheEntry cache[CLOCK_ZOOM_CACHE]);
+
+// Get the next key pressed in the clock window (SDL key code), 0 if none or
+// -1 if the window is being closed. Never refreshes the window.
+int PollKey(void);
+
+// Returns 1 for Shift, Ctrl, Alt and the other keys that are only held with
+// another key (SDL reports those as key presses too).
+int IsModifierKey(int key);
+
+// Write one line of the stats and keep the widest line in width.
+void StatsText(int y, char *text, int *width);
+
+#if CLOCK_DAMAGE_TRACKING == 1
+// Size the damage tracking to the ClockGeometry. The first frame after this
+// is a full clear and present. Returns 0 if out of memory.
+int InitDamage(ClockDamage *dmg, ClockGeometry *geo);
+void FreeDamage(ClockDamage *dmg);
+
+// Mark the tiles under a line or rectangle as changed.
+void DamageLine(ClockDamage *dmg, int x1, int y1, int x2, int y2);
+void DamageRect(ClockDamage *dmg, int x1, int y1, int x2, int y2);
+
+// Erase what the last frame drew. Returns the bytes of the page touched.
+long long EraseDamage(ClockDamage *dmg);
+
+// Copy the changed tiles of the page to the screen and show it. Returns the
+// bytes copied.
+long long PresentDamage(ClockDamage *dmg, int win_id);
+#endif
 
 // Calculate the time dilation for the velocity over 1 second.
 double GetTimeDilation(double v);
 
+// Calculate the TD rate as double-double for each radius point of the band
+// (1 - band)c to 1c.
+void CalcRatePrecise(double band, int radii, double *rate_hi, double *rate_lo);
+
+// Get the TD hand tick position at each radius point after ticks (1/60 sec).
+void TdPhasePrecise(const double *rate_hi, const double *rate_lo, int radii,
+                    int ticks, int *phase);
+
 // Calculate the velocity in m/s for each of the 500 radius points. The outer
 // tip of the second hand is traveling at 299792458m/s or C.
 int Get500RadiusMeterPerSecond(void);
 
+#if CLOCK_SHM_PUBLISH == 1
+// Create and map the shared memory segment for the clock state. Returns NULL
+// if it can't, or if another running clock already owns it.
+ClockShmSegment *ClockShmOpen(void);
+
+// Unmap and remove the shared memory segment and give up ownership.
+void ClockShmClose(ClockShmSegment *seg);
+
+// Get a monotonic time stamp in nanoseconds for timing the publish.
+long long ClockShmNanoTime(void);
+#endif
+
+// The unit circle shared by all of the clock tables.
+static double Unit_x[CLOCK_TICKS], Unit_y[CLOCK_TICKS];
+
+// Set by the background build thread when new tables are ready. The main loop
+// takes it with an atomic exchange. Geo_building is set while a build is in
+// flight so only one runs at a time.
+static ClockGeometry *Pending_geo = NULL;
+static int Geo_building = 0;
+
+#if CLOCK_SHM_PUBLISH == 1
+// The segment is held open with an exclusive advisory lock for as long as this
+// clock is the writer. The lock goes with the process if it crashes.
+static int Shm_lock_fd = -1;
+#endif
+
 //http://programmertutor16.blogspot.com/2013/10/analog-clock-in-c-simplified.html
 int main(int argc, char *argv[])
     {
@@ -151,8 +365,10 @@ int main(int argc, char *argv[])
 
     // Get clock times.
     int j, sec;
-    int midx, midy, radius, hr, min, sec3600;
+    int hr, min, sec3600;
     int msec = 0;
+    double min_phase;  // Minutes and fractions of a minute, 0.0 to 60.0
+    int hand_x, hand_y;
 
     // Initiate Time data structures.
     time_t t1;
@@ -160,26 +376,29 @@ int main(int argc, char *argv[])
     struct timeval tv;
     //struct timezone tz;  // Deprecated, use NULL.
 
-    // Initiate arrays to hold clock graphics data.
-    int x[12], y[12], minx[60], miny[60], n_minx[60], n_miny[60];
-    int hrx[12], hry[12];
-    int msecx[3600], msecy[3600];
     char str[256];
 
-    // Creat the look up tables for 500 * 3600 x.y plots.
-    // malloced array dimensions must be freed using the loop below.
-    //int td_plotx[500][3600], td_ploty[500][3600];
-    // approx 13.73291015625 MiB (x 2)
-    int q = 3600;  // Circumference plots.
-    int r = 500;  // Radius plots.
-    int e = 0;
-    int *td_plotx[r], *td_ploty[r];
-
-    for (e = 0; e < r; e++)
-        {
-        td_plotx[e] = (int*)malloc(q * sizeof(int));
-        td_ploty[e] = (int*)malloc(q * sizeof(int));
-        }
+    // The clock graphics data for the current window size, and the next set
+    // when a resize has finished building.
+    ClockGeometry *geo = NULL;
+    ClockGeometry *next_geo = NULL;
+    int req_width = 0, req_height = 0;  // Size of the last requested build.
+    int win_width, win_height;
+    int td_clip = 0;  // The tables don't fit the window, clip the plots.
+    int *td_plotx, *td_ploty;
+
+    // Zoom into the near C band of the TD hand.
+    ZoomCacheEntry zoom_cache[CLOCK_ZOOM_CACHE];
+#if CLOCK_PRECISE_TD == 1
+    double *td_rate_hi = NULL, *td_rate_lo = NULL;
+#else
+    double *td_velocity = NULL;
+#endif
+    ZoomCacheEntry *zoom_band = NULL;
+    unsigned long long frame = 0;
+    int zoom = 0;
+    int key = 0;
+    memset(zoom_cache, 0, sizeof(zoom_cache));
 
 
     int Last_min = -1;  // Test for minute roll over.
@@ -194,112 +413,234 @@ int main(int argc, char *argv[])
     // the array as they will continue to increase over time until the recorded
     // values exceed the size of double.
     // I have placed size limit test in the main routine for this.
+#if CLOCK_PRECISE_TD == 0
     double time_accumulative = 0;
+#endif
     // Calculates the current accumulation of the 3600 tick period (minutes).
     int time_accumulative_temp = 0;
+#if CLOCK_PRECISE_TD == 0
     // Hold the current 3600 (Minute) adjustment amount (incitements by 3600 per minute).
     int adjust3600 = 0;
+#endif
     int cnt2 = 0;  // Loop counter
 
+    // Frame timing for the stats and the shared memory snapshot.
+    long long frame_usec = 0;
+    long long last_usec = -1;
+
+    // Bytes of the page last cleared, and last uploaded to the screen texture
+    // (by the partial present or by a full refresh).
+    long long clear_bytes = 0;
+    long long present_bytes = 0;
+    int stats_w = 0;
+
+#if CLOCK_DAMAGE_TRACKING == 1
+    // What was drawn last frame. This uses the one page (no page flipping) as
+    // the erase works from the exact content of the page being drawn.
+    ClockDamage damage;
+    memset(&damage, 0, sizeof(damage));
+#endif
 
-    // Set the SDL windows options.
-    // Note! SDL_BGI is not resizable from the window border. But can be resized
-    // via internal resetwinoptions()
-    setwinoptions ("Time Dilation Clock - Any key to quit", // char *title
-                   SDL_WINDOWPOS_CENTERED, // int x
-                   SDL_WINDOWPOS_CENTERED, // int y
-                   -1); // Uint32 flags (See SDL_bgi.c setwinoptions for flags)
-
-    // only a subset of flag is supported for now
-    // From SDL_bgi.c
-    /*
-     if (flags & SDL_WINDOW_FULLSCREEN         ||
-         flags & SDL_WINDOW_FULLSCREEN_DESKTOP ||
-         flags & SDL_WINDOW_SHOWN              ||
-         flags & SDL_WINDOW_HIDDEN             ||
-         flags & SDL_WINDOW_BORDERLESS         ||
-         flags & SDL_WINDOW_MAXIMIZED          ||
-         flags & SDL_WINDOW_MINIMIZED) */
-
-         // Window can be resized via the application, but mouse possitions must be
-   // calculated for drag actions.
-   // SDL_WINDOW_RESIZABLE = 0x00000020,          < window can be resized
-
-    int Win_ID_1 = initwindow(WINDOW_X, WINDOW_Y);  // intiiate the graphics driver and window.(1280, 1024)
-    // It defaults to fast, so I don't think this is needed.
-    sdlbgifast();  // sdlbgiauto(void)
-
-
-    // mid position in x and y -axis
-    midx = getmaxx() / 2;
-    midy = getmaxy() / 2;
-    radius = midy - 4;  // 500
-    //printf("Radius = %d\n", radius);  // DEBUG
-    //int maxx = getmaxx();
-    //int maxy = getmaxy();
-
-    // Get position to locate Hr numbers in clock
-    calcPoints(radius - 50, midx, midy, x, y);
-
-    // Get position to locate MinSec numbers in clock
-    minSecCalc(radius - 20, midx, midy, n_minx, n_miny);
-
-    // Get position for hour needle
-    calcPoints(radius - 100, midx, midy, hrx, hry);
-
-    // Get position for minute needle
-    minSecCalc(radius - 70, midx, midy, minx, miny);
-
-    // Get position for seconds needle. 60 * 60 ticks per second = 3600
-    Calc3600(radius - 0, midx, midy, msecx, msecy);
-
-
-    // This calculates the complete x.y pixel lookup table for radius 500 times
-    // 3600 ticks per minute.
-    Calc3600_td(radius - 0, midx, midy, td_plotx, td_ploty);
+#if CLOCK_SHM_PUBLISH == 1
+    // Live clock state published each frame. If the segment cannot be created
+    // the clock still runs, it just doesn't publish.
+    ClockShmSegment *shm_seg = ClockShmOpen();
+    ClockShmState shm_state;
+    long long shm_start = 0;
+    long long publish_nsec = 0;
+    memset(&shm_state, 0, sizeof(shm_state));
+#endif
 
-    // Get the initial TD in m/s for 1 sec3600 (500 plots from center to radius)
-    int T_Radius = 500;
-    int counter = 0;
-    double Velocity[500];  // m/s / 60 for 500px radius
+    // 'F' switches between the window and full screen.
+    int fullscreen = CLOCK_FULLSCREEN;
+    int Win_ID_1 = OpenClockWindow(fullscreen);
+    int new_win_id;
 
 
-    // This obtains our time dilation accurate to 1 sec as a fraction 1/60th of 1 sec.
-    // This can also be represented as a meter per second calculation.
-    for ( counter = 0; counter < T_Radius; counter++)
+    // The first set of tables is built up front as there is nothing to render
+    // with until it is done. Later sets are built on the background thread.
+    CalcUnitCircle();
+    req_width = getmaxx() + 1;
+    req_height = getmaxy() + 1;
+    geo = BuildGeometry(req_width, req_height);
+#if CLOCK_DAMAGE_TRACKING == 1
+    if (geo != NULL && !InitDamage(&damage, geo))
         {
-        // The following gives meters per sec3600 for 1 second. Att 500 * radius units it should equal C (299792458)
-        // C = 299792458
-        // circumference = 17987547480m
-        // Radius = 2862807095.5421653553357478091848m (~2862807km |~distance from Sun to Uranus)
-        // Radius/500 = 5725614.1910843307106714956183696
-        // Velocity[counter] = 2 * M_PI * (5725614.19108 * (counter + 1))
-        //Velocity[counter] = ([2*Pi] * ([Radius/500] * (counter + 1)) / 60th of second);
-        Velocity[counter] = (6.28318530717958647692 * (5725614.1910843307106714956183696 * (counter + 1)) / 60);  // == m/s == meters
-        //printf("%f\n", Velocity[counter]);  // [0 +1]599584.916000 to [499 +1]299792458.000000
+        FreeGeometry(geo);
+        geo = NULL;
+        }
+#endif
+    if (geo == NULL)
+        {
+        printf("Out of memory for the clock tables!\n");
+        closewindow(Win_ID_1);
+        closegraph();
+#if CLOCK_SHM_PUBLISH == 1
+        // Or the segment is left behind with no clock to update it.
+        ClockShmClose(shm_seg);
+#endif
+        return 1;
         }
 
 
     // Main loop to update the clock graphics.
     // kbkit() is for the console emulator, xkbhit() is for the SDL window.
-    while (!xkbhit())// && !kbhit())
+    // The clock reads the SDL window events itself, see PollKey().
+    while (1)
         {
+        frame++;
+
+        // '+' and '-' (main or keypad) zoom the TD hand, 'F' full screen. Any
+        // other key quits, except Shift and the other modifier keys, as does
+        // the window close button.
+        key = PollKey();
+        if (key != 0)
+            {
+            if (key == 'f' || key == 'F')
+                {
+                // The new window is opened before the old one is closed so
+                // SDL_bgi is never left without a window.
+                fullscreen = !fullscreen;
+                new_win_id = OpenClockWindow(fullscreen);
+                closewindow(Win_ID_1);
+                Win_ID_1 = new_win_id;
+                setcurrentwindow(Win_ID_1);
+#if CLOCK_DAMAGE_TRACKING == 1
+                damage.valid = 0;  // The new page starts blank.
+#endif
+                }
+            else if (key == '+' || key == '=' || key == SDLK_KP_PLUS)
+                {
+                if (zoom < CLOCK_ZOOM_MAX)
+                    {
+                    zoom++;
+                    }
+                }
+            else if (key == '-' || key == '_' || key == SDLK_KP_MINUS)
+                {
+                if (zoom > 0)
+                    {
+                    zoom--;
+                    }
+                }
+            else if (!IsModifierKey(key))
+                {
+                break;
+                }
+            }
+
+        // Swap in a finished set of tables from the background thread. The
+        // old set is only freed here, after the last frame that used it.
+        next_geo = __atomic_exchange_n(&Pending_geo, NULL, __ATOMIC_ACQ_REL);
+        if (next_geo != NULL)
+            {
+#if CLOCK_DAMAGE_TRACKING == 1
+            if (!InitDamage(&damage, next_geo))
+                {
+                // Keep the old tables, this size won't be retried.
+                FreeGeometry(next_geo);
+                next_geo = geo;
+                }
+#endif
+            if (next_geo != geo)
+                {
+                FreeGeometry(geo);
+                geo = next_geo;
+                }
+            __atomic_store_n(&Geo_building, 0, __ATOMIC_RELEASE);
+            }
+
+        // Start a rebuild if the window size has changed. Only one build runs
+        // at a time, a size that changes again mid build is picked up after.
+        win_width = getmaxx() + 1;
+        win_height = getmaxy() + 1;
+        if ((win_width != geo->width || win_height != geo->height) &&
+            (win_width != req_width || win_height != req_height) &&
+            __atomic_load_n(&Geo_building, __ATOMIC_ACQUIRE) == 0)
+            {
+            if (StartGeometryBuild(win_width, win_height))
+                {
+                req_width = win_width;
+                req_height = win_height;
+                }
+            }
+
+        td_plotx = geo->td_plotx;
+        td_ploty = geo->td_ploty;
+        td_clip = (geo->width > win_width || geo->height > win_height ||
+                   geo->radius > geo->midx || geo->radius > geo->midy);
+
+        // The TD tables for each radius point of the current zoom band. Tables
+        // for the old radii after a resize are simply replaced in the cache.
+#if CLOCK_PRECISE_TD == 1
+        td_rate_hi = geo->rate_hi;
+        td_rate_lo = geo->rate_lo;
+#else
+        td_velocity = geo->velocity;
+#endif
+        if (zoom > 0)
+            {
+            zoom_band = GetZoomBand(zoom_cache, zoom, geo->radii, frame);
+            if (zoom_band == NULL)
+                {
+                zoom = 0;
+                }
+            else
+                {
+#if CLOCK_PRECISE_TD == 1
+                td_rate_hi = zoom_band->rate_hi;
+                td_rate_lo = zoom_band->rate_lo;
+#else
+                td_velocity = zoom_band->velocity;
+#endif
+                }
+            }
+
+#if CLOCK_DAMAGE_TRACKING == 1
+        // Erase the last frame from the page before any of this frame is drawn.
+        clear_bytes = EraseDamage(&damage);
+#endif
 
         // Write stats.
         settextstyle(TRIPLEX_FONT, 0, 1);
         settextjustify(LEFT_TEXT, CENTER_TEXT);
         setcolor (LIGHTGRAY);
         //setbkcolor (BLACK);
-        outtextxy (5, 5, "Radius step * 500: 5725614.1910843307106714956183696m" );
-        outtextxy (5, 30, "Radius: 2862807095.5421653553357478091848m" );
+        stats_w = 0;
+        sprintf(Buf_time_elapsed, "Radius step * %d: %.16gm", geo->radii, CLOCK_RADIUS_M / geo->radii);
+        StatsText (5, Buf_time_elapsed, &stats_w );
+        StatsText (30, "Radius: 2862807095.5421653553357478091848m", &stats_w );
 
-        outtextxy (5,55, "Circumference: 17987547480m" );
-        outtextxy (5, 80, "Circumference/60: 299792458 m/s" );
-        outtextxy (5, 105, "circumferenc steps: 3600 (60 FPS)" );
-        outtextxy (5, 130, "Scale: 1:5725614.191084331" );
+        StatsText (55, "Circumference: 17987547480m", &stats_w );
+        StatsText (80, "Circumference/60: 299792458 m/s", &stats_w );
+        StatsText (105, "circumferenc steps: 3600 (60 FPS)", &stats_w );
+        sprintf(Buf_time_elapsed, "Scale: 1:%.9f", CLOCK_RADIUS_M / geo->radius);
+        StatsText (130, Buf_time_elapsed, &stats_w );
 
         sprintf(Buf_time_elapsed, "Min elapsed: [%06d]", time_elapsed);
-        outtextxy (5, 155, Buf_time_elapsed );
+        StatsText (155, Buf_time_elapsed, &stats_w );
+
+        sprintf(Buf_time_elapsed, "Frame: %lld us  Clear: %lld KiB  Present: %lld KiB",
+                frame_usec, clear_bytes / 1024, present_bytes / 1024);
+        StatsText (180, Buf_time_elapsed, &stats_w );
+
+        sprintf(Buf_time_elapsed, "TD band: %.*fc to 1c (zoom %d, +/-)",
+                zoom, 1.0 - pow(10.0, -zoom), zoom);
+        StatsText (230, Buf_time_elapsed, &stats_w );
+
+#if CLOCK_SHM_PUBLISH == 1
+        if (shm_seg != NULL)
+            {
+            sprintf(Buf_time_elapsed, "SHM publish: %lld ns", publish_nsec);
+            StatsText (205, Buf_time_elapsed, &stats_w );
+            }
+#endif
+#if CLOCK_DAMAGE_TRACKING == 1
+        // The last line is centred on y 230.
+        damage.stats_w = stats_w + 10;
+        damage.stats_h = 230 + textheight(Buf_time_elapsed);
+        DamageRect(&damage, 0, 0, damage.stats_w, damage.stats_h);
+#endif
 
         // Draw the clock face (Old draw method)
         setlinestyle(SOLID_LINE, 1, 1);  // set line size for all (1|3)
@@ -310,12 +651,12 @@ int main(int argc, char *argv[])
         setcolor (DARKGRAY);
 
         // Draws frame of the clock
-        circle(midx, midy, radius +2);
+        circle(geo->midx, geo->midy, geo->radius +2);
 
 #if CLOCK_NUMERALS == 1
         // To remove the hours and minutes displays, comment out from here ==>
-        // Place the 60 sec numbers in clock
-        for (j = 0; j < 60; j++)
+        // Place the 60 sec numbers in clock (if they fit inside the face)
+        for (j = 0; j < 60 && geo->radius > 20; j++)
             {
             if (j == 0)
                 {
@@ -326,12 +667,13 @@ int main(int argc, char *argv[])
                 sprintf(str, "%d", j);
                 }
             settextjustify(CENTER_TEXT, CENTER_TEXT);
-            moveto(n_minx[j], n_miny[j]);
+            HandPoint(j / 60.0, geo->radius - 20, geo->midx, geo->midy, &hand_x, &hand_y);
+            moveto(hand_x, hand_y);
             outtext(str);
             }
 
         // Place the 12 numbers  in clock
-        for (j = 0; j < 12; j++)
+        for (j = 0; j < 12 && geo->radius > 50; j++)
             {
             if (j == 0)
                 {
@@ -342,7 +684,8 @@ int main(int argc, char *argv[])
                 sprintf(str, "%d", j);
                 }
             settextjustify(CENTER_TEXT, CENTER_TEXT);
-            moveto(x[j], y[j]);
+            HandPoint(j / 12.0, geo->radius - 50, geo->midx, geo->midy, &hand_x, &hand_y);
+            moveto(hand_x, hand_y);
             outtext(str);
             }
             // <== too here.
@@ -353,21 +696,54 @@ int main(int argc, char *argv[])
         data = localtime(&t1);
         gettimeofday(&tv, NULL);  //gettimeofday(&tv,&tz);
 
+        // Time between frames in microseconds.
+        if (last_usec != -1)
+            {
+            frame_usec = ((long long)tv.tv_sec * 1000000 + tv.tv_usec) - last_usec;
+            }
+        last_usec = (long long)tv.tv_sec * 1000000 + tv.tv_usec;
+
 
         // Note that the drawing order is important. Drawing starts at the back
         // layer in the Z order progressing up to the most front layer.
 
+        // The hour and minute needles follow the seconds (and microseconds)
+        // so they move smoothly between the hour and minute marks.
+        hr = data->tm_hour % 12;
+        min = data->tm_min % 60;
+        min_phase = min + ((data->tm_sec + (tv.tv_usec / 1000000.0)) / 60.0);
+
         // Draw the hour needle in clock
         // You can alter the colour of the hands with setcolor()
-        hr = data->tm_hour % 12;
         //setcolor(LIGHTGRAY);
-        line(midx, midy, hrx[hr], hry[hr]);
+        // A needle that doesn't fit a small face is left out. Its end point
+        // stays at the center so there is nothing to erase.
+        hand_x = geo->midx;
+        hand_y = geo->midy;
+        if (geo->radius > 100)
+            {
+            HandPoint((hr + (min_phase / 60.0)) / 12.0, geo->radius - 100, geo->midx, geo->midy, &hand_x, &hand_y);
+            line(geo->midx, geo->midy, hand_x, hand_y);
+            }
+#if CLOCK_DAMAGE_TRACKING == 1
+        damage.hand_x[0] = hand_x;
+        damage.hand_y[0] = hand_y;
+#endif
         //setcolor(WHITE);
 
         // Draw the minute needle in clock
-        min = data->tm_min % 60;
         //setcolor(LIGHTGRAY);
-        line(midx, midy, minx[min], miny[min]);
+        hand_x = geo->midx;
+        hand_y = geo->midy;
+        if (geo->radius > 70)
+            {
+            HandPoint(min_phase / 60.0, geo->radius - 70, geo->midx, geo->midy, &hand_x, &hand_y);
+            line(geo->midx, geo->midy, hand_x, hand_y);
+            }
+#if CLOCK_DAMAGE_TRACKING == 1
+        damage.hand_x[1] = hand_x;
+        damage.hand_y[1] = hand_y;
+#endif
         //setcolor(WHITE);
 
 
@@ -380,9 +756,18 @@ int main(int argc, char *argv[])
         sec3600 = (data->tm_sec * 60 +msec) % 3600;  //60 sec * 60 ticks/sec
 
         // Draw Second hand (Clock Time)
+        // This stays on the 3600 tick steps to keep in sync with the TD hand.
         setcolor(BLUE);  // LIGHTBLUE
-        line(midx, midy, msecx[sec3600], msecy[sec3600]);
-        //line(midx, midy, msecx[ticks], msecy[ticks]);
+        HandPoint((double)sec3600 / CLOCK_TICKS, geo->radius - 0, geo->midx, geo->midy, &hand_x, &hand_y);
+        line(geo->midx, geo->midy, hand_x, hand_y);
+#if CLOCK_DAMAGE_TRACKING == 1
+        damage.hand_x[2] = hand_x;
+        damage.hand_y[2] = hand_y;
+        for (j = 0; j < 3; j++)
+            {
+            DamageLine(&damage, damage.midx, damage.midy, damage.hand_x[j], damage.hand_y[j]);
+            }
+#endif
         //setcolor(WHITE);
 
 // #############################################################################
@@ -407,8 +792,16 @@ int main(int argc, char *argv[])
             }
 
 
+#if CLOCK_PRECISE_TD == 1
+        // The tick position of every radius point in one pass.
+        TdPhasePrecise(td_rate_hi, td_rate_lo, geo->radii, sec3600 + min3600, geo->td_phase);
+#endif
+
         // Calculate and draw the TD second hand.
-        for ( cnt2 = 0; cnt2 < T_Radius; cnt2++)   // + 1 for all results
+#if CLOCK_DAMAGE_TRACKING == 1
+        damage.td_count = 0;
+#endif
+        for ( cnt2 = 0; cnt2 < geo->radii; cnt2++)   // + 1 for all results
             {
 
             // The following gives meters per sec3600 for 1 second. At 500 * radius units it should equal C (299792458)
@@ -418,16 +811,19 @@ int main(int argc, char *argv[])
             // Radius/500 = 5725614.1910843307106714956183696
             //Velocity[counter] = ([2*Pi] * ([Radius/500] * (counter + 1)) / 60th of second);
 
-            //Velocity[500] is a pre-populated look up table of the velocity for each 1/60th second.
+            //velocity[radii] is a pre-populated look up table of the velocity for each 1/60th second.
             // I will need to change this to calculate from the real time seconds / 60.
 
+#if CLOCK_PRECISE_TD == 1
+            time_accumulative_temp = geo->td_phase[cnt2];
+#else
             // 3600th division up to 3600 seconds as
             //printf("sec3600=%d\n", sec3600);
             // time_accumulative is now real clock time. Gets current time.
-            time_accumulative = ((GetTimeDilation(Velocity[cnt2]) / 60.0 ) * (sec3600 + min3600));
+            time_accumulative = ((GetTimeDilation(td_velocity[cnt2]) / 60.0 ) * (sec3600 + min3600));
 
             // The following calculates time/tick counts above 3600 and adjusts
-            // so the the px are always withing the 500*3600 lookup table.
+            // so the the px are always withing the radii*3600 lookup table.
 
             // Get the closest integer from the double values converted to
             // 3600th steps of a circle.
@@ -444,23 +840,90 @@ int main(int argc, char *argv[])
                     // the 3600 point circle.
                 time_accumulative_temp -= (3600 * adjust3600);
                 }
+#endif
 
             // Draw the actual x.y plot of the accumulated time dilation for each radius point.
-            fputpixel (td_plotx[cnt2][time_accumulative_temp], td_ploty[cnt2][time_accumulative_temp] );
+            // fputpixel() doesn't clip, so while the window has shrunk and the
+            // new tables are still building, plots outside the window are skipped.
+            if (!td_clip ||
+                (td_plotx[cnt2 * CLOCK_TICKS + time_accumulative_temp] >= 0 &&
+                 td_ploty[cnt2 * CLOCK_TICKS + time_accumulative_temp] >= 0 &&
+                 td_plotx[cnt2 * CLOCK_TICKS + time_accumulative_temp] < win_width &&
+                 td_ploty[cnt2 * CLOCK_TICKS + time_accumulative_temp] < win_height))
+                {
+                fputpixel (td_plotx[cnt2 * CLOCK_TICKS + time_accumulative_temp],
+                           td_ploty[cnt2 * CLOCK_TICKS + time_accumulative_temp] );
+#if CLOCK_DAMAGE_TRACKING == 1
+                damage.td_x[damage.td_count] = td_plotx[cnt2 * CLOCK_TICKS + time_accumulative_temp];
+                damage.td_y[damage.td_count] = td_ploty[cnt2 * CLOCK_TICKS + time_accumulative_temp];
+                DamageRect(&damage, damage.td_x[damage.td_count], damage.td_y[damage.td_count],
+                           damage.td_x[damage.td_count], damage.td_y[damage.td_count]);
+                damage.td_count++;
+#endif
+                }
 
+#if CLOCK_SHM_PUBLISH == 1
+            if (cnt2 < CLOCK_SHM_RADII)
+                {
+                shm_state.td_phase[cnt2] = (int16_t)time_accumulative_temp;
+                }
+#endif
             }  // END Radius draw loop.
 
 
-        // Some safety on type limits for MAX_(Type)
+        // Some safety on type limits for MAX_(Type). The precise path has no
+        // accumulated double, only the tick count can run out.
+#if CLOCK_PRECISE_TD == 0
         if ((time_accumulative >= (DBL_MAX * 0.5)) || (min3600 > INT_MAX -7200))
+#else
+        if (min3600 > INT_MAX -7200)
+#endif
             {
             printf( "DBL_MAX or INT_MAX Limit reached!\n");
             break;
             }
 
+#if CLOCK_SHM_PUBLISH == 1
+        // Publish the state of this frame. The seqlock write never waits on
+        // readers. The cost of each publish is carried in the next snapshot.
+        if (shm_seg != NULL)
+            {
+            shm_start = ClockShmNanoTime();
+            shm_state.hr = hr;
+            shm_state.min = min;
+            shm_state.sec3600 = sec3600;
+            shm_state.min3600 = min3600;
+            shm_state.time_elapsed = time_elapsed;
+            shm_state.radii = (geo->radii < CLOCK_SHM_RADII) ? geo->radii : CLOCK_SHM_RADII;
+            shm_state.zoom = zoom;
+            shm_state.frame_usec = frame_usec;
+            shm_state.publish_nsec = publish_nsec;
+            shm_state.frame++;
+            shm_state.checksum = ClockShmChecksum(&shm_state);
+            ClockShmWrite(shm_seg, &shm_state);
+            publish_nsec = ClockShmNanoTime() - shm_start;
+            }
+#endif
+
 // #############################################################################
 
 
+#if CLOCK_DAMAGE_TRACKING == 1
+        // Copy only the changed tiles to the screen. The page itself is kept
+        // and the next frame erases just what was drawn on it. While a resize
+        // is still building the page no longer matches the tables, so it is a
+        // full refresh and a full clear once the new tables are in.
+        if (win_width == damage.width && win_height == damage.height)
+            {
+            present_bytes = PresentDamage(&damage, Win_ID_1);
+            }
+        else
+            {
+            refresh();
+            damage.valid = 0;
+            present_bytes = (long long)win_width * win_height * 4;
+            }
+#else
         // We can use double buffering wich is the standard method to create
         // smooth flowing animations without flicker.
         // Use void sdlbgifast (void); Mode + refresh()
@@ -478,6 +941,11 @@ int main(int argc, char *argv[])
         // Clears the display interface (background page).
         cleardevice();
 
+        // Full window cleared and presented (ARGB, 4 bytes per pixel).
+        present_bytes = (long long)win_width * win_height * 4;
+        clear_bytes = present_bytes;
+#endif
+
 
         // NOTE! SDL_Delay() can interfere with the SDL_Bgi
         // Sleep() vs delay(): Sleep can sometimes interfere with the graphics
@@ -499,247 +967,572 @@ int main(int argc, char *argv[])
     closewindow(Win_ID_1);
     closegraph();
 
-    // loop through each static dimension and clear the dynamic allocations.
-    for (e = 0; e < r; e++)
-        {
-        free(td_plotx[e]);
-        free(td_ploty[e]);
-        }
+#if CLOCK_SHM_PUBLISH == 1
+    ClockShmClose(shm_seg);
+#endif
+
+    // A build that is still running when we quit is left to the process exit.
+    FreeGeometry(__atomic_exchange_n(&Pending_geo, NULL, __ATOMIC_ACQ_REL));
+    FreeGeometry(geo);
+    FreeZoomCache(zoom_cache);
+#if CLOCK_DAMAGE_TRACKING == 1
+    FreeDamage(&damage);
+#endif
 
     return 0;
     }  // <== END main()
 
 
-// A modification of minSecCalc() to achieve 360 x,y points for the second
-// hand. (seconds * 6) + (millisecond / 166667)
-// 50 * 6 + 10 <- as weird as that seams we start at 0 to 359 in the array.
-void Calc3600(int radius, int midx, int midy, int secx[3600], int secy[3600])
+// The unit circle for all of the clock tables. Index 0 is 12 o'clock and
+// the points run clockwise, CLOCK_TICKS per rotation.
+// (x, y) == (sin(angle), -cos(angle)) as the screen y axis points down.
+void CalcUnitCircle(void)
     {
-    //int i, j = 0, x, y;
-    int i, j = 0;
-    //char str[32];
+    int i;
+    double angle;
 
-    /* 90 position(min/sec - 12 to 3) in first quadrant of clock  */
-    secx[j] = midx, secy[j++] = midy - radius;
-    for (i = 901; i < 1800; i = i + 1)  // +6
+    for (i = 0; i < CLOCK_TICKS; i++)
         {
-        secx[j] = midx - (radius * cos((i * 3.14) / 1800));
-        secy[j++] = midy - (radius * sin((i * 3.14) / 1800));
+        angle = (6.28318530717958647692 * i) / CLOCK_TICKS;
+        Unit_x[i] = sin(angle);
+        Unit_y[i] = -cos(angle);
         }
+    }
+
 
-    /* 90 positions(min or sec - 3 to 6) in second quadrant of clock */
-    secx[j] = midx + radius, secy[j++] = midy;
-    for (i = 1801; i < 2700; i = i + 1)  // +6
+// The plots of one TD radius point. Point i is at tick i (1/60 sec) of the
+// minute.
+void ScaleUnitCircle(int radius, int midx, int midy, int *secx, int *secy)
+    {
+    int i;
+
+    for (i = 0; i < CLOCK_TICKS; i++)
         {
-        secx[j] = midx - (radius * cos((i * 3.14) / 1800));
-        secy[j++] = midy - (radius * sin((i * 3.14) / 1800));
+        secx[i] = (int)(midx + (radius * Unit_x[i]));
+        secy[i] = (int)(midy + (radius * Unit_y[i]));
         }
+    }
 
-    /* 90 positions(min or sec - 6 to 9) in third quadrant of clock */
-    secx[j] = midx, secy[j++] = midy + radius;
-    for (i = 2701; i < 3600; i = i + 1)  // +6
+
+// The hand engine. The phase is spread over the CLOCK_TICKS points of the
+// unit circle and the point is interpolated between the two nearest, so any
+// phase gives a smooth position.
+void HandPoint(double phase, int length, int midx, int midy, int *x, int *y)
+    {
+    double tick = (phase - floor(phase)) * CLOCK_TICKS;
+    int i = (int)tick;
+    int i2;
+    double frac = tick - i;
+
+    if (i >= CLOCK_TICKS)
         {
-        secx[j] = midx - (radius * cos((i * 3.14) / 1800));
-        secy[j++] = midy - (radius * sin((i * 3.14) / 1800));
+        i = 0;  // phase a hair below 1.0 rounded up to a full rotation.
+        frac = 0;
         }
+    i2 = (i + 1 < CLOCK_TICKS) ? i + 1 : 0;
+
+    *x = (int)(midx + (length * (Unit_x[i] + ((Unit_x[i2] - Unit_x[i]) * frac))));
+    *y = (int)(midy + (length * (Unit_y[i] + ((Unit_y[i2] - Unit_y[i]) * frac))));
+    }
+
 
-    /* 90 positions(min or sec - 9 to 12) in fourth quadrant of clock */
-    secx[j] = midx - radius, secy[j++] = midy;
-    for (i = 1; i < 900; i = i + 1)  // +6
+// SDL_bgi can't change the size of a window once it is open. resetwinoptions()
+// only changes the title and position and a window drawn bigger from the
+// border keeps its page size. So each change between the window and full
+// screen is a new window, and the clock picks up its size from getmaxx(),
+// getmaxy() on the next frame.
+int OpenClockWindow(int fullscreen)
+    {
+    int win_id;
+
+    // Set the SDL windows options.
+    setwinoptions ("Time Dilation Clock - +/- zoom, F full screen, any other key quits", // char *title
+                   SDL_WINDOWPOS_CENTERED, // int x
+                   SDL_WINDOWPOS_CENTERED, // int y
+                   // Uint32 flags (See SDL_bgi.c setwinoptions for flags)
+                   // -1 would keep the flags of the last window.
+                   (fullscreen) ? SDL_WINDOW_FULLSCREEN_DESKTOP : SDL_WINDOW_SHOWN);
+
+    // only a subset of flag is supported for now
+    // From SDL_bgi.c
+    /*
+     if (flags & SDL_WINDOW_FULLSCREEN         ||
+         flags & SDL_WINDOW_FULLSCREEN_DESKTOP ||
+         flags & SDL_WINDOW_SHOWN              ||
+         flags & SDL_WINDOW_HIDDEN             ||
+         flags & SDL_WINDOW_BORDERLESS         ||
+         flags & SDL_WINDOW_MAXIMIZED          ||
+         flags & SDL_WINDOW_MINIMIZED) */
+
+    if (fullscreen)
+        {
+        win_id = initwindow(0, 0);  // 0, 0 == full screen at the desktop size.
+        }
+    else
         {
-        secx[j] = midx - (radius * cos((i * 3.14) / 1800));
-        secy[j++] = midy - (radius * sin((i * 3.14) / 1800));
+        win_id = initwindow(WINDOW_X, WINDOW_Y);  // intiiate the graphics driver and window.(1280, 1024)
         }
+    // It defaults to fast, so I don't think this is needed.
+    sdlbgifast();  // sdlbgiauto(void)
 
+    return win_id;
     }
 
 
-// Dilation Plot version
-// A modification of minSecCalc() to achieve 3600 x,y points for the second
-// hand. (seconds * 60) + (millisecond / 166667)
-// 3600 x,y plots are calculated for each of the 500 radius points.
-void Calc3600_td(int radius, int midx, int midy, int **secx, int **secy)
+// Build all of the clock tables for a window of width x height. The radius
+// (500 for the default 1410x1010 window) and the number of TD radius points
+// follow the window size.
+// The TD tables hold radii * 3600 x.y plots, approx 13.7 MiB (x 2) for 500.
+// Returns NULL if out of memory.
+ClockGeometry *BuildGeometry(int width, int height)
     {
-    //int i, j = 0, x, y;
-    int i, j = 0;
-    //char str[32];
-    radius = radius;
-    int td_count1 = 0;
-    for (td_count1 = 0; td_count1 < 500; td_count1++)
-        {
-        j = 0;
-
-        // 90 position(min/sec - 12 to 3) in first quadrant of clock
-        secx[td_count1][j] = midx, secy[td_count1][j++] = midy - td_count1;
-        for (i = 901; i < 1800; i = i + 1)  // +6
-            {
-            secx[td_count1][j] = midx - (td_count1 * cos((i * 3.14) / 1800));
-            secy[td_count1][j++] = midy - (td_count1 * sin((i * 3.14) / 1800));
-            }
+    ClockGeometry *geo = (ClockGeometry*)calloc(1, sizeof(ClockGeometry));
+    int counter;
+
+    if (geo == NULL)
+        {
+        return NULL;
+        }
+
+    // mid position in x and y -axis
+    geo->width = width;
+    geo->height = height;
+    geo->midx = (width - 1) / 2;
+    geo->midy = (height - 1) / 2;
+    // The face always fits the window. On a small window the hands and
+    // numerals that don't fit are left out rather than growing the face.
+    geo->radius = ((geo->midx < geo->midy) ? geo->midx : geo->midy) - 4;
+    if (geo->radius < 1)
+        {
+        geo->radius = 1;  // A window only a few pixels across.
+        }
+    geo->radii = geo->radius;
+
+#if CLOCK_PRECISE_TD == 1
+    geo->rate_hi = (double*)malloc(geo->radii * sizeof(double));
+    geo->rate_lo = (double*)malloc(geo->radii * sizeof(double));
+    geo->td_phase = (int*)malloc(geo->radii * sizeof(int));
+#else
+    geo->velocity = (double*)malloc(geo->radii * sizeof(double));
+#endif
+    geo->td_plotx = (int*)malloc((size_t)geo->radii * CLOCK_TICKS * sizeof(int));
+    geo->td_ploty = (int*)malloc((size_t)geo->radii * CLOCK_TICKS * sizeof(int));
+#if CLOCK_PRECISE_TD == 1
+    if (geo->rate_hi == NULL || geo->rate_lo == NULL || geo->td_phase == NULL ||
+        geo->td_plotx == NULL || geo->td_ploty == NULL)
+#else
+    if (geo->velocity == NULL || geo->td_plotx == NULL || geo->td_ploty == NULL)
+#endif
+        {
+        FreeGeometry(geo);
+        return NULL;
+        }
+
+    // The complete x.y pixel lookup table for each radius point times 3600
+    // ticks per minute. Radius point n is plotted at n pixels from the center.
+    for (counter = 0; counter < geo->radii; counter++)
+        {
+        ScaleUnitCircle(counter, geo->midx, geo->midy,
+                        &geo->td_plotx[counter * CLOCK_TICKS],
+                        &geo->td_ploty[counter * CLOCK_TICKS]);
+        }
+
+#if CLOCK_PRECISE_TD == 1
+    // The 0c to 1c band, worked from 1 - v/C.
+    CalcRatePrecise(1.0, geo->radii, geo->rate_hi, geo->rate_lo);
+#else
+    // This obtains our time dilation accurate to 1 sec as a fraction 1/60th of 1 sec.
+    // This can also be represented as a meter per second calculation.
+    for (counter = 0; counter < geo->radii; counter++)
+        {
+        // The following gives meters per sec3600 for 1 second. At radii * radius units it should equal C (299792458)
+        // C = 299792458
+        // circumference = 17987547480m
+        // Radius = 2862807095.5421653553357478091848m (~2862807km |~distance from Sun to Uranus)
+        // Radius/500 = 5725614.1910843307106714956183696
+        //velocity[counter] = ([2*Pi] * ([Radius/radii] * (counter + 1)) / 60th of second);
+        geo->velocity[counter] = (6.28318530717958647692 * ((CLOCK_RADIUS_M / geo->radii) * (counter + 1)) / 60);  // == m/s == meters
+        //printf("%f\n", velocity[counter]);  // [0 +1]599584.916000 to [499 +1]299792458.000000
+        }
+#endif
+
+    return geo;
+    }
 
-        // 90 positions(min or sec - 3 to 6) in second quadrant of clock
-        secx[td_count1][j] = midx + td_count1, secy[td_count1][j++] = midy;
-        for (i = 1801; i < 2700; i = i + 1)  // +6
-            {
-            secx[td_count1][j] = midx - (td_count1 * cos((i * 3.14) / 1800));
-            secy[td_count1][j++] = midy - (td_count1 * sin((i * 3.14) / 1800));
-            }
 
-        // 90 positions(min or sec - 6 to 9) in third quadrant of clock
-        secx[td_count1][j] = midx, secy[td_count1][j++] = midy + td_count1;
-        for (i = 2701; i < 3600; i = i + 1)  // +6
+void FreeGeometry(ClockGeometry *geo)
+    {
+    if (geo == NULL)
+        {
+        return;
+        }
+#if CLOCK_PRECISE_TD == 1
+    free(geo->rate_hi);
+    free(geo->rate_lo);
+    free(geo->td_phase);
+#else
+    free(geo->velocity);
+#endif
+    free(geo->td_plotx);
+    free(geo->td_ploty);
+    free(geo);
+    }
+
+
+// Start the background build for a new window size.
+int StartGeometryBuild(int width, int height)
+    {
+    pthread_t thread;
+    pthread_attr_t attr;
+    int *size = (int*)malloc(2 * sizeof(int));
+    int ok;
+
+    if (size == NULL)
+        {
+        return 0;
+        }
+    size[0] = width;
+    size[1] = height;
+
+    __atomic_store_n(&Geo_building, 1, __ATOMIC_RELEASE);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ok = (pthread_create(&thread, &attr, GeometryBuildThread, size) == 0);
+    pthread_attr_destroy(&attr);
+
+    if (!ok)
+        {
+        free(size);
+        __atomic_store_n(&Geo_building, 0, __ATOMIC_RELEASE);
+        }
+    return ok;
+    }
+
+
+// Builds the tables and hands them to the main loop. If the build fails the
+// main loop keeps the old tables and won't retry the same size.
+void *GeometryBuildThread(void *arg)
+    {
+    int *size = (int*)arg;
+    ClockGeometry *geo = BuildGeometry(size[0], size[1]);
+
+    free(size);
+    if (geo == NULL)
+        {
+        __atomic_store_n(&Geo_building, 0, __ATOMIC_RELEASE);
+        return NULL;
+        }
+    __atomic_store_n(&Pending_geo, geo, __ATOMIC_RELEASE);
+    return NULL;
+    }
+
+
+// Shift is needed for '+' on most layouts and the lock keys can be toggled at
+// any time, so none of these quit the clock. 'F' is handled before this.
+int IsModifierKey(int key)
+    {
+    switch (key)
+        {
+        case SDLK_LSHIFT:
+        case SDLK_RSHIFT:
+        case SDLK_LCTRL:
+        case SDLK_RCTRL:
+        case SDLK_LALT:
+        case SDLK_RALT:
+        case SDLK_LGUI:
+        case SDLK_RGUI:
+        case SDLK_MODE:  // AltGr
+        case SDLK_CAPSLOCK:
+        case SDLK_NUMLOCKCLEAR:
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+
+// Zoom level n spreads the velocity band (1 - 10^-n)c to 1c over the radius
+// points, the outer point is always C. The band is worked from 1 - v/C so
+// the small steps near C aren't lost adding to a value close to 1.
+ZoomCacheEntry *GetZoomBand(ZoomCacheEntry cache[CLOCK_ZOOM_CACHE], int level,
+                            int radii, unsigned long long frame)
+    {
+    ZoomCacheEntry *entry = &cache[0];
+    double band;  // 1 - v/C at the inner edge of the band.
+    int i;
+
+    for (i = 0; i < CLOCK_ZOOM_CACHE; i++)
+        {
+        if (cache[i].level == level && cache[i].radii == radii)
             {
-            secx[td_count1][j] = midx - (td_count1 * cos((i * 3.14) / 1800));
-            secy[td_count1][j++] = midy - (td_count1 * sin((i * 3.14) / 1800));
+            cache[i].used = frame;
+            return &cache[i];
             }
-
-        // 90 positions(min or sec - 9 to 12) in fourth quadrant of clock
-        secx[td_count1][j] = midx - td_count1, secy[td_count1][j++] = midy;
-        for (i = 1; i < 900; i = i + 1)  // +6
+        // Keep the empty or least recently used entry for replacement.
+        if (cache[i].used < entry->used)
             {
-            secx[td_count1][j] = midx - (td_count1 * cos((i * 3.14) / 1800));
-            secy[td_count1][j++] = midy - (td_count1 * sin((i * 3.14) / 1800));
+            entry = &cache[i];
             }
+        }
 
+    entry->level = 0;
+    entry->used = 0;
+    band = pow(10.0, -level);
+#if CLOCK_PRECISE_TD == 1
+    free(entry->rate_hi);
+    free(entry->rate_lo);
+    entry->rate_hi = (double*)malloc(radii * sizeof(double));
+    entry->rate_lo = (double*)malloc(radii * sizeof(double));
+    if (entry->rate_hi == NULL || entry->rate_lo == NULL)
+        {
+        return NULL;
+        }
+    CalcRatePrecise(band, radii, entry->rate_hi, entry->rate_lo);
+#else
+    free(entry->velocity);
+    entry->velocity = (double*)malloc(radii * sizeof(double));
+    if (entry->velocity == NULL)
+        {
+        return NULL;
+        }
+    for (i = 0; i < radii; i++)
+        {
+        entry->velocity[i] = CLOCK_C * (1.0 - band * ((double)(radii - 1 - i) / radii));
         }
+#endif
 
+    entry->level = level;
+    entry->radii = radii;
+    entry->used = frame;
+    return entry;
     }
 
 
-// A modification of minSecCalc() to achieve 360 x,y points for the second
-// hand. (seconds * 6) + (millisecond / 166667)
-// 50 * 6 + 10 <- as weird as that seams we start at 0 to 359 in the array.
-void Calc360(int radius, int midx, int midy, int secx[360], int secy[360])
+void FreeZoomCache(ZoomCacheEntry cache[CLOCK_ZOOM_CACHE])
     {
-    //int i, j = 0, x, y;
-    int i, j = 0;
-    //char str[32];
+    int i;
 
-    /* 90 position(min/sec - 12 to 3) in first quadrant of clock  */
-    secx[j] = midx, secy[j++] = midy - radius;
-    for (i = 91; i < 180; i = i + 1)  // +6
+    for (i = 0; i < CLOCK_ZOOM_CACHE; i++)
         {
-        secx[j] = midx - (radius * cos((i * 3.14) / 180));
-        secy[j++] = midy - (radius * sin((i * 3.14) / 180));
+#if CLOCK_PRECISE_TD == 1
+        free(cache[i].rate_hi);
+        free(cache[i].rate_lo);
+        cache[i].rate_hi = NULL;
+        cache[i].rate_lo = NULL;
+#else
+        free(cache[i].velocity);
+        cache[i].velocity = NULL;
+#endif
+        cache[i].level = 0;
+        cache[i].used = 0;
         }
+    }
+
+
+// The SDL events are read here rather than with xkbhit(). SDL_bgi refreshes
+// the whole window in xkbhit() when it is not in fast mode, which would undo
+// the partial present of the damage tracking. Other events are not used.
+int PollKey(void)
+    {
+    SDL_Event event;
 
-    /* 90 positions(min or sec - 3 to 6) in second quadrant of clock */
-    secx[j] = midx + radius, secy[j++] = midy;
-    for (i = 181; i < 270; i = i + 1)  // +6
+    while (SDL_PollEvent(&event))
         {
-        secx[j] = midx - (radius * cos((i * 3.14) / 180));
-        secy[j++] = midy - (radius * sin((i * 3.14) / 180));
+        if (event.type == SDL_QUIT ||
+            (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE))
+            {
+            return -1;
+            }
+        if (event.type == SDL_KEYDOWN)
+            {
+            return event.key.keysym.sym;
+            }
         }
+    return 0;
+    }
+
 
-    /* 90 positions(min or sec - 6 to 9) in third quadrant of clock */
-    secx[j] = midx, secy[j++] = midy + radius;
-    for (i = 271; i < 360; i = i + 1)  // +6
+void StatsText(int y, char *text, int *width)
+    {
+    outtextxy (5, y, text );
+    if (textwidth(text) > *width)
         {
-        secx[j] = midx - (radius * cos((i * 3.14) / 180));
-        secy[j++] = midy - (radius * sin((i * 3.14) / 180));
+        *width = textwidth(text);
         }
+    }
+
 
-    /* 90 positions(min or sec - 9 to 12) in fourth quadrant of clock */
-    secx[j] = midx - radius, secy[j++] = midy;
-    for (i = 1; i < 90; i = i + 1)  // +6
+#if CLOCK_DAMAGE_TRACKING == 1
+int InitDamage(ClockDamage *dmg, ClockGeometry *geo)
+    {
+    int *td_x = (int*)malloc(geo->radii * sizeof(int));
+    int *td_y = (int*)malloc(geo->radii * sizeof(int));
+    int cols = (geo->width + CLOCK_DAMAGE_TILE - 1) / CLOCK_DAMAGE_TILE;
+    int rows = (geo->height + CLOCK_DAMAGE_TILE - 1) / CLOCK_DAMAGE_TILE;
+    unsigned char *tiles = (unsigned char*)calloc(cols * rows, 1);
+
+    if (td_x == NULL || td_y == NULL || tiles == NULL)
         {
-        secx[j] = midx - (radius * cos((i * 3.14) / 180));
-        secy[j++] = midy - (radius * sin((i * 3.14) / 180));
+        free(td_x);
+        free(td_y);
+        free(tiles);
+        return 0;
         }
 
+    FreeDamage(dmg);
+    dmg->td_x = td_x;
+    dmg->td_y = td_y;
+    dmg->tiles = tiles;
+    dmg->cols = cols;
+    dmg->rows = rows;
+    dmg->width = geo->width;
+    dmg->height = geo->height;
+    dmg->midx = geo->midx;
+    dmg->midy = geo->midy;
+    return 1;
     }
 
 
+void FreeDamage(ClockDamage *dmg)
+    {
+    free(dmg->td_x);
+    free(dmg->td_y);
+    free(dmg->tiles);
+    memset(dmg, 0, sizeof(*dmg));
+    }
 
-//==============================================================================
-// http://see-programming.blogspot.com/2013/09/c-program-to-implement-analog-clock.html
-/*
-   * Calculates position for minute and second needle movement
-   * Each quadrant has 90 degrees.  So, we need to split each
-   * quadrant into 15 parts(6 degree each) to get the minute
-   * and second needle movement
-*/
-void minSecCalc(int radius, int midx, int midy, int secx[60], int secy[60])
+
+void DamageRect(ClockDamage *dmg, int x1, int y1, int x2, int y2)
     {
-    //int i, j = 0, x, y;
-    int i, j = 0;
-    //char str[32];
+    int col, row;
+    int col1 = ((x1 < x2) ? x1 : x2) / CLOCK_DAMAGE_TILE;
+    int col2 = ((x1 < x2) ? x2 : x1) / CLOCK_DAMAGE_TILE;
+    int row1 = ((y1 < y2) ? y1 : y2) / CLOCK_DAMAGE_TILE;
+    int row2 = ((y1 < y2) ? y2 : y1) / CLOCK_DAMAGE_TILE;
+
+    if (col1 < 0) col1 = 0;
+    if (row1 < 0) row1 = 0;
+    if (col2 >= dmg->cols) col2 = dmg->cols - 1;
+    if (row2 >= dmg->rows) row2 = dmg->rows - 1;
+
+    for (row = row1; row <= row2; row++)
+        {
+        for (col = col1; col <= col2; col++)
+            {
+            dmg->tiles[row * dmg->cols + col] = 1;
+            }
+        }
+    }
+
 
-    /* 15 position(min/sec - 12 to 3) in first quadrant of clock  */
-    secx[j] = midx, secy[j++] = midy - radius;
+// The line is split into pieces no longer than half a tile. The box around
+// each piece, plus 1 pixel for the rounding of line() against the integer
+// steps here, covers every tile the piece passes through.
+void DamageLine(ClockDamage *dmg, int x1, int y1, int x2, int y2)
+    {
+    int dx = x2 - x1, dy = y2 - y1;
+    int len = (abs(dx) > abs(dy)) ? abs(dx) : abs(dy);
+    int steps = (len / (CLOCK_DAMAGE_TILE / 2)) + 1;
+    int i, ax = x1, ay = y1, bx, by;
 
-    for (i = 96; i < 180; i = i + 6)
+    for (i = 1; i <= steps; i++)
         {
-        secx[j] = midx - (radius * cos((i * 3.14) / 180));
-        secy[j++] = midy - (radius * sin((i * 3.14) / 180));
+        bx = x1 + (dx * i) / steps;
+        by = y1 + (dy * i) / steps;
+        DamageRect(dmg, ((ax < bx) ? ax : bx) - 1, ((ay < by) ? ay : by) - 1,
+                   ((ax < bx) ? bx : ax) + 1, ((ay < by) ? by : ay) + 1);
+        ax = bx;
+        ay = by;
         }
+    }
+
 
-    /* 15 positions(min or sec - 3 to 6) in second quadrant of clock */
-    secx[j] = midx + radius, secy[j++] = midy;
-    for (i = 186; i < 270; i = i + 6)
+// The needles are drawn over in black with the same line() so exactly the same
+// pixels are erased. The clock frame and numerals are redrawn every frame so
+// anything of them erased here comes back. The erased tiles are marked so the
+// next present copies them to the screen.
+long long EraseDamage(ClockDamage *dmg)
+    {
+    long long bytes = 0;
+    int i, dx, dy;
+
+    if (!dmg->valid)
         {
-        secx[j] = midx - (radius * cos((i * 3.14) / 180));
-        secy[j++] = midy - (radius * sin((i * 3.14) / 180));
+        cleardevice();
+        DamageRect(dmg, 0, 0, dmg->width - 1, dmg->height - 1);
+        dmg->valid = 1;
+        return (long long)dmg->width * dmg->height * 4;
         }
 
-    /* 15 positions(min or sec - 6 to 9) in third quadrant of clock */
-    secx[j] = midx, secy[j++] = midy + radius;
-    for (i = 276; i < 360; i = i + 6)
+    setfillstyle(SOLID_FILL, BLACK);
+    bar(0, 0, dmg->stats_w, dmg->stats_h);
+    DamageRect(dmg, 0, 0, dmg->stats_w, dmg->stats_h);
+    bytes += (long long)(dmg->stats_w + 1) * (dmg->stats_h + 1) * 4;
+
+    setcolor(BLACK);
+    for (i = 0; i < 3; i++)
         {
-        secx[j] = midx - (radius * cos((i * 3.14) / 180));
-        secy[j++] = midy - (radius * sin((i * 3.14) / 180));
+        line(dmg->midx, dmg->midy, dmg->hand_x[i], dmg->hand_y[i]);
+        DamageLine(dmg, dmg->midx, dmg->midy, dmg->hand_x[i], dmg->hand_y[i]);
+        dx = abs(dmg->hand_x[i] - dmg->midx);
+        dy = abs(dmg->hand_y[i] - dmg->midy);
+        bytes += (((dx > dy) ? dx : dy) + 1) * 4;
         }
 
-    /* 15 positions(min or sec - 9 to 12) in fourth quadrant of clock */
-    secx[j] = midx - radius, secy[j++] = midy;
-    for (i = 6; i < 90; i = i + 6)
+    for (i = 0; i < dmg->td_count; i++)
         {
-        secx[j] = midx - (radius * cos((i * 3.14) / 180));
-        secy[j++] = midy - (radius * sin((i * 3.14) / 180));
+        fputpixel(dmg->td_x[i], dmg->td_y[i]);
+        DamageRect(dmg, dmg->td_x[i], dmg->td_y[i], dmg->td_x[i], dmg->td_y[i]);
         }
+    bytes += dmg->td_count * 4;
 
-    return;
+    return bytes;
     }
 
-/*
-   * find the points at 0, 30, 60,.., 360 degrees
-   * on the given circle.  x value corresponds to
-   * radius * cos(angle) and y value corresponds
-   * to radius * sin(angle).  Numbers in the clock
-   * are written using the above manipulated x and
-   * y values.  And the hour needle movement
-   * is based on this
-*/
-
-void calcPoints(int radius, int midx, int midy, int x[12], int y[12])
+
+// Each run of changed tiles along a row is copied to the SDL_bgi texture in
+// one update. The changed tiles hold both what was erased and what was drawn.
+// SDL2 has no partial present, so the texture is then shown as a whole.
+long long PresentDamage(ClockDamage *dmg, int win_id)
     {
-    int x1, y1;
-
-    /* 90, 270, 0, 180 degrees */
-    x[0] = midx, y[0] = midy - radius;
-    x[6] = midx, y[6] = midy + radius;
-    x[3] = midx + radius, y[3] = midy;
-    x[9] = midx - radius, y[9] = midy;
-
-    /* 30, 150, 210, 330 degrees */
-    x1 = (int) ((radius / 2) * sqrt(3));
-    y1 = (radius / 2);
-    x[2] = midx + x1, y[2] = midy - y1;
-    x[4] = midx + x1, y[4] = midy + y1;
-    x[8] = midx - x1, y[8] = midy + y1;
-    x[10] = midx - x1, y[10] = midy - y1;
-
-    /* 60, 120, 210, 300 degrees */
-    x1 = radius / 2;
-    y1 = (int) ((radius / 2)  * sqrt(3));
-    x[1] = midx + x1, y[1] = midy - y1;
-    x[5] = midx + x1, y[5] = midy + y1;
-    x[7] = midx - x1, y[7] = midy + y1;
-    x[11] = midx - x1, y[11] = midy - y1;
-
-    return;
+    long long bytes = 0;
+    SDL_Rect rect;
+    Uint32 *pixels = bgi_activepage[win_id];
+    int row, col, run;
+
+    for (row = 0; row < dmg->rows; row++)
+        {
+        for (col = 0; col < dmg->cols; col += run)
+            {
+            run = 1;
+            if (!dmg->tiles[row * dmg->cols + col])
+                {
+                continue;
+                }
+            while (col + run < dmg->cols && dmg->tiles[row * dmg->cols + col + run])
+                {
+                run++;
+                }
+            memset(&dmg->tiles[row * dmg->cols + col], 0, run);
+
+            rect.x = col * CLOCK_DAMAGE_TILE;
+            rect.y = row * CLOCK_DAMAGE_TILE;
+            rect.w = run * CLOCK_DAMAGE_TILE;
+            rect.h = CLOCK_DAMAGE_TILE;
+            if (rect.x + rect.w > dmg->width) rect.w = dmg->width - rect.x;
+            if (rect.y + rect.h > dmg->height) rect.h = dmg->height - rect.y;
+
+            SDL_UpdateTexture(bgi_texture, &rect, pixels + (rect.y * dmg->width) + rect.x,
+                              dmg->width * sizeof(Uint32));
+            bytes += (long long)rect.w * rect.h * 4;
+            }
+        }
+
+    SDL_RenderCopy(bgi_renderer, bgi_texture, NULL, NULL);
+    SDL_RenderPresent(bgi_renderer);
+    return bytes;
     }
-//==============================================================================
+#endif
 
 
 // Returns seconds per 1 second.
@@ -772,4 +1565,175 @@ double GetTimeDilation(double v)  //double velocity, double distance)
     }
 
 
+// The exact product of a and b as p + e (p is the rounded product). Uses the
+// hardware fma if there is one, else Dekker's split of each value into two
+// halves whose products are exact.
+static inline void TwoProd(double a, double b, double *p, double *e)
+    {
+#ifdef FP_FAST_FMA
+    *p = a * b;
+    *e = fma(a, b, -*p);
+#else
+    double split = 134217729.0;  // 2^27 + 1
+    double ta = split * a, tb = split * b;
+    double ah = ta - (ta - a), al = a - ah;
+    double bh = tb - (tb - b), bl = b - bh;
+
+    *p = a * b;
+    *e = (((ah * bh - *p) + ah * bl) + al * bh) + al * bl;
+#endif
+    }
+
+
+// Radius point n of the band sits at 1 - v/C = band * (radii - 1 - n) / radii,
+// the outer point is always C. The time dilation is
+// sqrt(1 - (v/C)^2) == sqrt((1 - v/C) * (1 + v/C))
+// where neither factor loses anything near C. The product is kept exact as a
+// double-double and the square root is refined by one Newton step:
+// rate_lo = (x - rate_hi^2) / (2 * rate_hi)
+void CalcRatePrecise(double band, int radii, double *rate_hi, double *rate_lo)
+    {
+    double one_minus, one_plus_hi, one_plus_lo;
+    double x_hi, x_lo, s, ss_hi, ss_lo;
+    int i;
+
+    for (i = 0; i < radii; i++)
+        {
+        one_minus = band * ((double)(radii - 1 - i) / radii);
+
+        // 1 + v/C == 2 - (1 - v/C), exactly as hi + lo.
+        one_plus_hi = 2.0 - one_minus;
+        one_plus_lo = (2.0 - one_plus_hi) - one_minus;
+
+        TwoProd(one_minus, one_plus_hi, &x_hi, &x_lo);
+        x_lo += one_minus * one_plus_lo;
+
+        s = sqrt(x_hi);
+        rate_hi[i] = s;
+        rate_lo[i] = 0;
+        if (s > 0)
+            {
+            TwoProd(s, s, &ss_hi, &ss_lo);
+            rate_lo[i] = (((x_hi - ss_hi) - ss_lo) + x_lo) / (2.0 * s);
+            }
+        }
+    }
+
+
+// The same as round(rate * ticks) % 3600 in the plain path, but rate * ticks
+// is kept exact as a double-double so no ticks are lost however large ticks
+// grows. The whole rotations are taken off the hi part, which is exact as
+// both are whole multiples of its last bit, before the lo part is added.
+// There are no branches or calls in the loop so GCC can vectorize it. floor()
+// is not vectorized by default, so the casts to int (round toward 0) stand in
+// for it. rate * ticks is never negative and the remainder r is never below
+// -0.5, where the two would differ.
+void TdPhasePrecise(const double *rate_hi, const double *rate_lo, int radii,
+                    int ticks, int *phase)
+    {
+    double t = ticks;
+    double p, e, q, r;
+    int i, k;
+
+    for (i = 0; i < radii; i++)
+        {
+        TwoProd(rate_hi[i], t, &p, &e);
+        e += rate_lo[i] * t;
+
+        // Whole rotations. q can be 1 high if p / 3600 rounds up, r is then a
+        // hair below 0 and still rounds to tick 0.
+        q = (int)(p / CLOCK_TICKS);
+        r = (p - (q * CLOCK_TICKS)) + e;
+
+        k = (int)(r + 0.5);
+        k = (k >= CLOCK_TICKS) ? k - CLOCK_TICKS : k;
+        phase[i] = k;
+        }
+    }
+
+
+#if CLOCK_SHM_PUBLISH == 1
+// Create the shared memory object, size it to the fixed layout and map it.
+// Returns NULL (and the clock runs without publishing) on any failure.
+// The seqlock allows only one writer, so the segment is only taken if no
+// other clock holds the lock on it. A segment left behind by a clock that
+// crashed has no lock and is simply reused.
+ClockShmSegment *ClockShmOpen(void)
+    {
+    ClockShmSegment *seg;
+    int fd = shm_open(CLOCK_SHM_NAME, O_CREAT | O_RDWR, 0644);
+
+    if (fd == -1)
+        {
+        perror("shm_open");
+        return NULL;
+        }
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1)
+        {
+        if (errno == EWOULDBLOCK)
+            {
+            printf("Another clock is publishing to %s, not publishing.\n",
+                   CLOCK_SHM_NAME);
+            }
+        else
+            {
+            perror("flock");
+            }
+        close(fd);
+        return NULL;
+        }
+    if (ftruncate(fd, sizeof(ClockShmSegment)) == -1)
+        {
+        perror("ftruncate");
+        close(fd);
+        return NULL;
+        }
+
+    seg = (ClockShmSegment*)mmap(NULL, sizeof(ClockShmSegment),
+                                 PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (seg == MAP_FAILED)
+        {
+        perror("mmap");
+        close(fd);
+        return NULL;
+        }
+    // The fd is kept open as closing it would drop the lock.
+    Shm_lock_fd = fd;
+
+    // Start from an even (stable) sequence with an empty state. The magic is
+    // written last so readers don't accept a half initialised segment.
+    memset(seg, 0, sizeof(*seg));
+    seg->version = CLOCK_SHM_VERSION;
+    __atomic_store_n(&seg->magic, CLOCK_SHM_MAGIC, __ATOMIC_RELEASE);
+    return seg;
+    }
+
+
+// Readers that still have the segment mapped keep the last snapshot, new
+// readers will fail to open it. Only the owner gets here, so a second clock
+// that was refused the segment never removes it.
+void ClockShmClose(ClockShmSegment *seg)
+    {
+    if (seg == NULL)
+        {
+        return;
+        }
+    munmap(seg, sizeof(ClockShmSegment));
+    // Unlink before the lock is dropped so that a clock starting now gets a
+    // fresh segment rather than the one being removed.
+    shm_unlink(CLOCK_SHM_NAME);
+    close(Shm_lock_fd);
+    Shm_lock_fd = -1;
+    }
+
+
+long long ClockShmNanoTime(void)
+    {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+#endif
+
+
 //==============================================================================
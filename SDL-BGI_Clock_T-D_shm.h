@@ -0,0 +1,138 @@
+//------------------------------------------------------------------------------
+// Name:        SDL-BGI_Clock_T-D_shm.h
+// Purpose:     Shared memory snapshot of the live clock state.
+// Title:       "Time Dilation Clock"
+//
+// Platform:    Ubuntu64 (POSIX shared memory)
+//
+// Compiler:    GCC V9.x.x (ISO C99 + GCC __atomic builtins)
+// Depends:     librt (shm_open) on older glibc.
+//
+// Author:      Axle
+// Licence:     MIT
+//------------------------------------------------------------------------------
+// NOTES:
+// The clock publishes a fixed layout snapshot of its state once per frame into
+// the POSIX shared memory object CLOCK_SHM_NAME. Other local processes (overlay
+// and monitoring tools) can map it read only and get the hand positions and the
+// per radius TD phase without scraping pixels or repeating the math.
+//
+// The snapshot is guarded by a sequence lock (seqlock). The writer bumps the
+// sequence to an odd number, writes the payload and bumps it back to even.
+// Readers copy the payload and retry if the sequence was odd or changed while
+// they were copying. The writer never waits on readers and readers never see
+// a half written (torn) snapshot.
+//
+// The layout is fixed and versioned. Any change to ClockShmState must bump
+// CLOCK_SHM_VERSION so that old readers refuse the new layout.
+//------------------------------------------------------------------------------
+
+#ifndef SDL_BGI_CLOCK_T_D_SHM_H
+#define SDL_BGI_CLOCK_T_D_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define CLOCK_SHM_NAME "/sdl_bgi_clock_td"
+#define CLOCK_SHM_MAGIC 0x43544443u  // "CDTC"
+#define CLOCK_SHM_VERSION 3u
+
+// Maximum number of radius points held in the snapshot. The clock has one
+// radius point per pixel of radius, 500 in the default window.
+#define CLOCK_SHM_RADII 4096
+
+// The clock state for one frame.
+typedef struct
+    {
+    int32_t hr;  // 0 to 11
+    int32_t min;  // 0 to 59
+    int32_t sec3600;  // 0 to 3599 (60 sec * 60 ticks/sec)
+    int32_t min3600;  // Accumulated minute ticks since start (3600 per minute).
+    int32_t time_elapsed;  // Minutes elapsed since start.
+    int32_t radii;  // Number of valid entries in td_phase[].
+    int32_t zoom;  // TD band (1 - 10^-zoom)c to 1c over the radii.
+    int32_t reserved;
+    int64_t frame_usec;  // Wall time of the last frame in microseconds.
+    int64_t publish_nsec;  // Writer cost of the previous publish in nanoseconds.
+    uint64_t frame;  // Frame counter.
+    int16_t td_phase[CLOCK_SHM_RADII];  // TD hand 3600 tick position per radius.
+    uint32_t checksum;  // Sum of the fields above, for reader validation.
+    } ClockShmState;
+
+// The complete shared memory object.
+typedef struct
+    {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seq;  // Seqlock sequence. Odd while the writer is busy.
+    uint32_t pad;
+    ClockShmState state;
+    } ClockShmSegment;
+
+
+// Simple checksum over the payload so readers (and the stress test in the
+// reader tool) can confirm that a copied snapshot is not torn.
+static inline uint32_t ClockShmChecksum(const ClockShmState *s)
+    {
+    uint32_t sum = 0;
+    int i, radii = s->radii;
+
+    // Only the valid radius points. radii is clamped as a torn copy can hold
+    // any value.
+    if (radii < 0 || radii > CLOCK_SHM_RADII)
+        {
+        radii = CLOCK_SHM_RADII;
+        }
+
+    sum += (uint32_t)s->hr + (uint32_t)s->min + (uint32_t)s->sec3600;
+    sum += (uint32_t)s->min3600 + (uint32_t)s->time_elapsed + (uint32_t)s->radii;
+    sum += (uint32_t)s->zoom;
+    sum += (uint32_t)s->frame_usec + (uint32_t)s->publish_nsec;
+    sum += (uint32_t)s->frame;
+    for (i = 0; i < radii; i++)
+        {
+        sum = sum * 31 + (uint16_t)s->td_phase[i];
+        }
+    return sum;
+    }
+
+
+// Writer side. There must only ever be one writer (the clock).
+static inline void ClockShmWrite(ClockShmSegment *seg, const ClockShmState *s)
+    {
+    uint32_t seq = __atomic_load_n(&seg->seq, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&seg->seq, seq + 1, __ATOMIC_RELAXED);  // Odd == busy.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&seg->state, s, sizeof(*s));
+    __atomic_store_n(&seg->seq, seq + 2, __ATOMIC_RELEASE);  // Even == stable.
+    }
+
+
+// Reader side. Returns the number of retries needed, or -1 if the writer was
+// busy for max_tries attempts in a row. Never blocks the writer.
+static inline int ClockShmRead(const ClockShmSegment *seg, ClockShmState *out,
+                               int max_tries)
+    {
+    uint32_t seq1, seq2;
+    int tries;
+
+    for (tries = 0; tries < max_tries; tries++)
+        {
+        seq1 = __atomic_load_n(&seg->seq, __ATOMIC_ACQUIRE);
+        if (seq1 & 1)
+            {
+            continue;  // Writer is mid update.
+            }
+        memcpy(out, (const void *)&seg->state, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq2 = __atomic_load_n(&seg->seq, __ATOMIC_RELAXED);
+        if (seq1 == seq2)
+            {
+            return tries;
+            }
+        }
+    return -1;
+    }
+
+#endif  // SDL_BGI_CLOCK_T_D_SHM_H
@@ -0,0 +1,259 @@
+//------------------------------------------------------------------------------
+// Name:        SDL-BGI_Clock_T-D_shm_reader.c
+// Purpose:     Read the live clock state published by the Time Dilation Clock.
+// Title:       "Time Dilation Clock - shared memory reader"
+//
+// Platform:    Ubuntu64
+//
+// Compiler:    GCC V9.x.x (ISO C99 + GCC __atomic builtins)
+// Depends:     SDL-BGI_Clock_T-D_shm.h, pthreads
+// Build:       gcc -O2 SDL-BGI_Clock_T-D_shm_reader.c -o clock_shm_reader
+//              -lpthread -lrt
+//
+// Author:      Axle
+// Licence:     MIT
+//------------------------------------------------------------------------------
+// NOTES:
+// Usage:
+//   clock_shm_reader            Print the clock state once per second.
+//   clock_shm_reader -s N [S]   Stress test. N reader threads copy snapshots
+//                               as fast as they can for S seconds (default 10)
+//                               while the clock is running. Every copy is
+//                               checked against its checksum and frame order.
+//                               Any torn read is reported and counted. The
+//                               writer cost of every frame published during
+//                               the test is averaged.
+//
+// The reader maps the segment read only, so it can never disturb the clock.
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "SDL-BGI_Clock_T-D_shm.h"
+
+// Retries before a read is given up as "writer busy".
+#define READ_TRIES 1000
+
+// Results from each stress thread.
+typedef struct
+    {
+    const ClockShmSegment *seg;
+    volatile int *stop;
+    unsigned long long reads;
+    unsigned long long retries;
+    unsigned long long busy;
+    unsigned long long torn;
+    unsigned long long backwards;
+    } StressArgs;
+
+const ClockShmSegment *OpenSegment(void);
+void PrintState(const ClockShmState *s);
+void *StressThread(void *arg);
+int RunStress(const ClockShmSegment *seg, int threads, int seconds);
+
+
+int main(int argc, char *argv[])
+    {
+    const ClockShmSegment *seg = OpenSegment();
+    ClockShmState state;
+    uint64_t last_frame = 0;
+
+    if (seg == NULL)
+        {
+        return 1;
+        }
+
+    if (argc >= 3 && strcmp(argv[1], "-s") == 0)
+        {
+        return RunStress(seg, atoi(argv[2]), (argc >= 4) ? atoi(argv[3]) : 10);
+        }
+
+    while (1)
+        {
+        if (ClockShmRead(seg, &state, READ_TRIES) < 0)
+            {
+            printf("Writer busy, retrying.\n");
+            }
+        else if (state.frame == last_frame)
+            {
+            printf("Clock is not running (frame %llu).\n",
+                   (unsigned long long)state.frame);
+            }
+        else
+            {
+            PrintState(&state);
+            last_frame = state.frame;
+            }
+        sleep(1);
+        }
+
+    return 0;
+    }
+
+
+// Map the clock segment read only and check that the layout matches.
+const ClockShmSegment *OpenSegment(void)
+    {
+    const ClockShmSegment *seg;
+    int fd = shm_open(CLOCK_SHM_NAME, O_RDONLY, 0);
+
+    if (fd == -1)
+        {
+        perror("shm_open (is the clock running?)");
+        return NULL;
+        }
+    seg = (const ClockShmSegment*)mmap(NULL, sizeof(ClockShmSegment),
+                                       PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED)
+        {
+        perror("mmap");
+        return NULL;
+        }
+
+    if (__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != CLOCK_SHM_MAGIC ||
+        seg->version != CLOCK_SHM_VERSION)
+        {
+        fprintf(stderr, "Unknown clock segment layout (version %u, expected %u).\n",
+                seg->version, CLOCK_SHM_VERSION);
+        return NULL;
+        }
+    return seg;
+    }
+
+
+void PrintState(const ClockShmState *s)
+    {
+    int last = (s->radii > 0) ? s->radii - 1 : 0;
+
+    printf("frame %llu  %02d:%02d  sec3600 %04d  min elapsed %d  "
+           "zoom %d  TD[0] %d TD[%d] %d  frame %lld us  publish %lld ns\n",
+           (unsigned long long)s->frame, s->hr, s->min, s->sec3600,
+           s->time_elapsed, s->zoom, s->td_phase[0], last, s->td_phase[last],
+           (long long)s->frame_usec, (long long)s->publish_nsec);
+    }
+
+
+void *StressThread(void *arg)
+    {
+    StressArgs *a = (StressArgs*)arg;
+    ClockShmState state;
+    uint64_t last_frame = 0;
+    int tries;
+
+    while (!*a->stop)
+        {
+        tries = ClockShmRead(a->seg, &state, READ_TRIES);
+        if (tries < 0)
+            {
+            a->busy++;
+            continue;
+            }
+        a->reads++;
+        a->retries += tries;
+        if (state.checksum != ClockShmChecksum(&state))
+            {
+            a->torn++;
+            }
+        if (state.frame < last_frame)
+            {
+            a->backwards++;
+            }
+        last_frame = state.frame;
+        }
+    return NULL;
+    }
+
+
+// Hammer the segment with many readers and report any torn or out of order
+// snapshots. The writer side cost is read from the published snapshot.
+int RunStress(const ClockShmSegment *seg, int threads, int seconds)
+    {
+    pthread_t *tid;
+    StressArgs *args;
+    volatile int stop = 0;
+    ClockShmState first, last, sample;
+    unsigned long long reads = 0, retries = 0, busy = 0, torn = 0, backwards = 0;
+    unsigned long long publish_sum = 0, publish_count = 0;
+    long long publish_max = 0;
+    uint64_t sample_frame = 0;
+    time_t end;
+    int i;
+
+    if (threads < 1 || seconds < 1)
+        {
+        fprintf(stderr, "Usage: -s <threads> [seconds]\n");
+        return 1;
+        }
+
+    tid = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    args = (StressArgs*)calloc(threads, sizeof(StressArgs));
+    if (tid == NULL || args == NULL)
+        {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+        }
+
+    ClockShmRead(seg, &first, READ_TRIES);
+    for (i = 0; i < threads; i++)
+        {
+        args[i].seg = seg;
+        args[i].stop = &stop;
+        pthread_create(&tid[i], NULL, StressThread, &args[i]);
+        }
+
+    // Sample each frame once for the writer cost it carries. publish_nsec is
+    // the cost of the publish before it.
+    end = time(NULL) + seconds;
+    while (time(NULL) < end)
+        {
+        if (ClockShmRead(seg, &sample, READ_TRIES) >= 0 &&
+            sample.frame != sample_frame && sample.frame > first.frame + 1)
+            {
+            publish_sum += sample.publish_nsec;
+            publish_count++;
+            if (sample.publish_nsec > publish_max)
+                {
+                publish_max = sample.publish_nsec;
+                }
+            sample_frame = sample.frame;
+            }
+        usleep(1000);
+        }
+    stop = 1;
+
+    for (i = 0; i < threads; i++)
+        {
+        pthread_join(tid[i], NULL);
+        reads += args[i].reads;
+        retries += args[i].retries;
+        busy += args[i].busy;
+        torn += args[i].torn;
+        backwards += args[i].backwards;
+        }
+    ClockShmRead(seg, &last, READ_TRIES);
+
+    printf("Readers:        %d for %d s\n", threads, seconds);
+    printf("Frames written: %llu\n", (unsigned long long)(last.frame - first.frame));
+    printf("Reads:          %llu (%.0f/s)\n", reads, (double)reads / seconds);
+    printf("Retries:        %llu\n", retries);
+    printf("Writer busy:    %llu\n", busy);
+    printf("Torn reads:     %llu\n", torn);
+    printf("Out of order:   %llu\n", backwards);
+    if (publish_count > 0)
+        {
+        printf("Writer cost:    %llu ns per publish average, %lld ns max (%llu frames)\n",
+               publish_sum / publish_count, publish_max, publish_count);
+        }
+
+    free(tid);
+    free(args);
+    return (torn == 0 && backwards == 0) ? 0 : 2;
+    }